@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <string.h>
 #include "bmpreader.h"
+#include "memtrack.h"
+#include "rng.h"
 //1
 // Загрузка BMP файла
 struct BMPImage* readBMP(const char* filename) {
@@ -13,7 +15,7 @@ struct BMPImage* readBMP(const char* filename) {
         return NULL;
     }
 
-    struct BMPImage *img = malloc(sizeof(struct BMPImage));
+    struct BMPImage *img = mem_alloc(sizeof(struct BMPImage));
     if (!img) {
         fclose(f);
         return NULL;
@@ -23,14 +25,14 @@ struct BMPImage* readBMP(const char* filename) {
     if (fread(&img->fileHeader, sizeof(struct BMPFileHeader), 1, f) != 1) {
         fprintf(stderr, "Error: cannot read file header\n");
         fclose(f);
-        free(img);
+        mem_free(img);
         return NULL;
     }
 
     if (fread(&img->infoHeader, sizeof(struct BMPInfoHeader), 1, f) != 1) {
         fprintf(stderr, "Error: cannot read info header\n");
         fclose(f);
-        free(img);
+        mem_free(img);
         return NULL;
     }
 
@@ -38,7 +40,7 @@ struct BMPImage* readBMP(const char* filename) {
     if (img->fileHeader.bfType != 0x4D42) { // 'BM'
         fprintf(stderr, "Error: not a BMP file (signature: 0x%04X)\n", img->fileHeader.bfType);
         fclose(f);
-        free(img);
+        mem_free(img);
         return NULL;
     }
 
@@ -47,7 +49,7 @@ struct BMPImage* readBMP(const char* filename) {
         fprintf(stderr, "Error: only 24-bit BMP supported. This is %d-bit\n",
                 img->infoHeader.biBitCount);
         fclose(f);
-        free(img);
+        mem_free(img);
         return NULL;
     }
 
@@ -60,12 +62,19 @@ struct BMPImage* readBMP(const char* filename) {
         abs_height = -height;
     }
 
+    if (width <= 0 || abs_height == 0) {
+        fprintf(stderr, "Error: invalid image size %dx%d\n", width, height);
+        fclose(f);
+        mem_free(img);
+        return NULL;
+    }
+
     // Выделяем память для пикселей
-    img->data = malloc(width * abs_height * sizeof(struct Pixel));
+    img->data = mem_alloc((size_t)width * abs_height * sizeof(struct Pixel));
     if (!img->data) {
         fprintf(stderr, "Error: cannot allocate memory for image data\n");
         fclose(f);
-        free(img);
+        mem_free(img);
         return NULL;
     }
 
@@ -89,8 +98,8 @@ struct BMPImage* readBMP(const char* filename) {
                 if (fread(&pixel, sizeof(struct Pixel), 1, f) != 1) {
                     fprintf(stderr, "Error: cannot read pixel at (%d, %d)\n", x, y);
                     fclose(f);
-                    free(img->data);
-                    free(img);
+                    mem_free(img->data);
+                    mem_free(img);
                     return NULL;
                 }
                 img->data[y * width + x] = pixel;
@@ -108,8 +117,8 @@ struct BMPImage* readBMP(const char* filename) {
                 if (fread(&pixel, sizeof(struct Pixel), 1, f) != 1) {
                     fprintf(stderr, "Error: cannot read pixel at (%d, %d)\n", x, y);
                     fclose(f);
-                    free(img->data);
-                    free(img);
+                    mem_free(img->data);
+                    mem_free(img);
                     return NULL;
                 }
                 img->data[y * width + x] = pixel;
@@ -126,11 +135,82 @@ struct BMPImage* readBMP(const char* filename) {
     return img;
 }
 
-// Алиас для совместимости
+// Синтетическое изображение: градиенты, шахматка и шум из PCG32.
+// Зависит только от размеров, поэтому годится как эталонный вход
+struct BMPImage* create_synthetic_bmp(int width, int height) {
+    int abs_height = (height < 0) ? -height : height;
+    if (width <= 0 || abs_height == 0) {
+        fprintf(stderr, "Error: invalid synthetic image size %dx%d\n", width, height);
+        return NULL;
+    }
+
+    struct BMPImage *img = mem_alloc(sizeof(struct BMPImage));
+    if (!img) return NULL;
+    img->data = mem_alloc((size_t)width * abs_height * sizeof(struct Pixel));
+    if (!img->data) {
+        fprintf(stderr, "Error: cannot allocate memory for image data\n");
+        mem_free(img);
+        return NULL;
+    }
+
+    int row_size = width * 3;
+    int padding = (4 - (row_size % 4)) % 4;
+    memset(&img->fileHeader, 0, sizeof(struct BMPFileHeader));
+    memset(&img->infoHeader, 0, sizeof(struct BMPInfoHeader));
+    img->fileHeader.bfType = 0x4D42;
+    img->fileHeader.bfOffBits = 54;
+    img->infoHeader.biSize = 40;
+    img->infoHeader.biWidth = width;
+    img->infoHeader.biHeight = height;
+    img->infoHeader.biPlanes = 1;
+    img->infoHeader.biBitCount = 24;
+    img->infoHeader.biSizeImage = (row_size + padding) * abs_height;
+    img->fileHeader.bfSize = 54 + img->infoHeader.biSizeImage;
+
+    struct Rng rng;
+    rng_seed(&rng, ((uint64_t)(uint32_t)width << 32) | (uint32_t)height, 0);
+    for (int y = 0; y < abs_height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t noise = rng_next(&rng);
+            int checker = ((x / 8) + (y / 8)) % 2 ? 64 : 0;
+            img->data[(size_t)y * width + x] = (struct Pixel){
+                (uint8_t)((x * 255 / width + (noise & 31)) & 0xFF),
+                (uint8_t)((y * 255 / abs_height + checker) & 0xFF),
+                (uint8_t)(((x + y) * 4 + ((noise >> 8) & 15)) & 0xFF)
+            };
+        }
+    }
+    return img;
+}
+
+// Алиас для совместимости. Имя вида "synth:WxH" создает синтетическое
+// изображение вместо чтения файла (H < 0 - строки сверху вниз)
 struct BMPImage* load_bmp(const char* filename) {
+    int width, height;
+    if (sscanf(filename, "synth:%dx%d", &width, &height) == 2) {
+        return create_synthetic_bmp(width, height);
+    }
     return readBMP(filename);
 }
 
+// FNV-1a по размерам и пикселям: отпечаток результата для сравнения с эталоном
+uint64_t image_hash(struct BMPImage* img) {
+    uint64_t hash = 14695981039346656037ULL;
+    uint32_t dims[2] = {(uint32_t)img->infoHeader.biWidth, (uint32_t)img->infoHeader.biHeight};
+    for (int d = 0; d < 2; d++) {
+        for (int i = 0; i < 4; i++) {
+            hash = (hash ^ ((dims[d] >> (8 * i)) & 0xFF)) * 1099511628211ULL;
+        }
+    }
+
+    size_t count = (size_t)img->infoHeader.biWidth * abs(img->infoHeader.biHeight) * sizeof(struct Pixel);
+    const uint8_t *bytes = (const uint8_t *)img->data;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
 // Сохранение BMP файла
 int save_bmp(const char* filename, struct BMPImage* img) {
     if (!img || !img->data) {
@@ -164,7 +244,7 @@ int save_bmp(const char* filename, struct BMPImage* img) {
     fwrite(&img->infoHeader, sizeof(struct BMPInfoHeader), 1, f);
 
     // Записываем данные
-    uint8_t pad_byte = 0;
+    uint8_t pad_bytes[3] = {0, 0, 0};   // паддинг строки - до 3 байт
 
     if (height > 0) {
         // Строки снизу вверх
@@ -175,7 +255,7 @@ int save_bmp(const char* filename, struct BMPImage* img) {
             }
             // Записываем паддинг
             if (padding > 0) {
-                fwrite(&pad_byte, 1, padding, f);
+                fwrite(pad_bytes, 1, padding, f);
             }
         }
     } else {
@@ -187,7 +267,7 @@ int save_bmp(const char* filename, struct BMPImage* img) {
             }
             // Записываем паддинг
             if (padding > 0) {
-                fwrite(&pad_byte, 1, padding, f);
+                fwrite(pad_bytes, 1, padding, f);
             }
         }
     }
@@ -232,8 +312,8 @@ void print_bmp_info(struct BMPImage* img) {
 void free_bmp(struct BMPImage *img) {
     if (img) {
         if (img->data) {
-            free(img->data);
+            mem_free(img->data);
         }
-        free(img);
+        mem_free(img);
     }
 }
\ No newline at end of file
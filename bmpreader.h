@@ -54,6 +54,8 @@ void free_bmp(struct BMPImage *img);                       // Освобожде
 
 // Вспомогательные функции
 int validate_bmp(struct BMPImage* img);                    // Проверка корректности BMP
+struct BMPImage* create_synthetic_bmp(int width, int height); // Детерминированное тестовое изображение
+uint64_t image_hash(struct BMPImage* img);                 // Отпечаток пикселей (FNV-1a)
 void print_bmp_info(struct BMPImage* img);                 // Вывод информации о BMP
 
 #endif //LABIP_BMPREADER_H
\ No newline at end of file
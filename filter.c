@@ -5,13 +5,24 @@
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "bmpreader.h"
+#include "memtrack.h"
 #include "filter.h"
+#include "stats.h"
+#include "rng.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 //1
+static int clamp_index(int i, int n) {
+    if (i < 0) return 0;
+    if (i >= n) return n - 1;
+    return i;
+}
+
 struct Pixel checkPixel(struct BMPImage *img, int x, int y) {
     int w = img->infoHeader.biWidth;
     int h = abs(img->infoHeader.biHeight);
@@ -22,17 +33,88 @@ struct Pixel checkPixel(struct BMPImage *img, int x, int y) {
     return img->data[y * w + x];
 }
 
-void apply_transform(struct BMPImage *img, PixelTransform transform, void* params) {
+// Окрестность: строка y результата зависит только от строк y-r..y+r.
+// Исходные строки держим в скользящем окне из 2r+1 строк, а результат
+// пишем сразу в img->data. Каждая строка окна хранится дважды (в слотах
+// s mod n и s mod n + n), поэтому окно всегда лежит в буфере непрерывно
+static int apply_neighborhood_in_place(struct BMPImage *img, PixelTransform transform,
+                                       void *params, int radius) {
     int w = img->infoHeader.biWidth;
     int h = abs(img->infoHeader.biHeight);
-    struct Pixel *new = malloc(w * h * sizeof(struct Pixel));
+    int n = 2 * radius + 1;
+    size_t row_bytes = (size_t)w * sizeof(struct Pixel);
+
+    struct Pixel *buffer = mem_alloc(2 * n * row_bytes);
+    if (!buffer) return -1;
+
+    // Окно - маленькое изображение высотой n; строки за краем уже
+    // продублированы, поэтому checkPixel внутри окна ведет себя как в полном
+    struct BMPImage window = *img;
+    window.infoHeader.biHeight = n;
+
+    for (int s = -radius; s < radius; s++) {
+        int slot = ((s % n) + n) % n;
+        const struct Pixel *src = img->data + (size_t)clamp_index(s, h) * w;
+        memcpy(buffer + slot * w, src, row_bytes);
+        memcpy(buffer + (slot + n) * w, src, row_bytes);
+    }
+
+    for (int y = 0; y < h; y++) {
+        // Нижняя строка окна еще не перезаписана: мы пишем только строки <= y
+        int s = y + radius;
+        int slot = s % n;
+        const struct Pixel *src = img->data + (size_t)clamp_index(s, h) * w;
+        memcpy(buffer + slot * w, src, row_bytes);
+        memcpy(buffer + (slot + n) * w, src, row_bytes);
+
+        window.data = buffer + (size_t)(((y - radius) % n + n) % n) * w;
+        struct Pixel *out = img->data + (size_t)y * w;
+        for (int x = 0; x < w; x++) {
+            out[x] = transform(x, radius, &window, params);
+        }
+    }
+
+    mem_free(buffer);
+    return 0;
+}
+
+int apply_transform(struct BMPImage *img, PixelTransform transform, void* params,
+                    struct AccessPattern access) {
+    int w = img->infoHeader.biWidth;
+    int h = abs(img->infoHeader.biHeight);
+
+    // Поточечные фильтры: пиксель зависит только от себя - считаем на месте
+    if (access.kind == ACCESS_POINT) {
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                img->data[y * w + x] = transform(x, y, img, params);
+            }
+        }
+        return 0;
+    }
+
+    if (access.kind == ACCESS_NEIGHBORHOOD) {
+        if (apply_neighborhood_in_place(img, transform, params, access.radius) != 0) {
+            fprintf(stderr, "Error: cannot allocate memory for filter\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    // Геометрические фильтры читают произвольные пиксели - нужна полная копия
+    struct Pixel *new = mem_alloc((size_t)w * h * sizeof(struct Pixel));
+    if (!new) {
+        fprintf(stderr, "Error: cannot allocate memory for filter\n");
+        return -1;
+    }
     for (int y = 0; y < h; y++) {
         for (int x = 0; x < w; x++) {
             new[y * w + x] = transform(x, y, img, params);
         }
     }
-    free(img->data);
+    mem_free(img->data);
     img->data = new;
+    return 0;
 }
 
 struct Pixel formula_transform(int x, int y, struct BMPImage *img, void * params) {
@@ -68,11 +150,8 @@ struct Pixel matrix_transform(int x, int y, struct BMPImage *img, void * params)
     return (struct Pixel){(uint8_t)newB, (uint8_t)newG, (uint8_t)newR};
 }
 
-struct matrixFilter * create_gauss_kernel(int radius, float sigma) {
-    int size = 2 * radius + 1;
-    struct matrixFilter *p = malloc(sizeof(struct matrixFilter));
-    p->size = size;
-    p->matrix = malloc(size * size * sizeof(float));
+static void fill_gauss_matrix(struct matrixFilter *p, float sigma) {
+    int size = p->size;
     float sum = 0.0f;
     int offset = size / 2;
 
@@ -92,10 +171,161 @@ struct matrixFilter * create_gauss_kernel(int radius, float sigma) {
             p->matrix[i] /= sum;
         }
     }
+    p->sigma = sigma;
+}
+
+struct matrixFilter * create_gauss_kernel(int radius, float sigma) {
+    int size = 2 * radius + 1;
+    struct matrixFilter *p = mem_alloc(sizeof(struct matrixFilter));
+    if (!p) return NULL;
+    p->size = size;
+    p->matrix = mem_alloc(size * size * sizeof(float));
+    if (!p->matrix) {
+        mem_free(p);
+        return NULL;
+    }
+    p->id = (radius == 2) ? KERNEL_GAUSS_5 : KERNEL_GENERIC;
+    fill_gauss_matrix(p, sigma);
+    return p;
+}
+
+struct matrixFilter *create_sharp_kernel(void) {
+    static const float sharp_kernel[9] = { 0.0f, -1.0f,  0.0f,
+                                          -1.0f,  5.0f, -1.0f,
+                                           0.0f, -1.0f,  0.0f};
+    struct matrixFilter *p = mem_alloc(sizeof(struct matrixFilter));
+    if (!p) return NULL;
+    p->size = 3;
+    p->id = KERNEL_SHARP;
+    p->sigma = 0.0f;
+    p->matrix = mem_alloc(9 * sizeof(float));
+    if (!p->matrix) {
+        mem_free(p);
+        return NULL;
+    }
+    memcpy(p->matrix, sharp_kernel, 9 * sizeof(float));
+    return p;
+}
 
+struct matrixFilter *create_laplace_kernel(void) {
+    static const float laplace_kernel[9] = { 0.0f, -1.0f,  0.0f,
+                                            -1.0f,  4.0f, -1.0f,
+                                             0.0f, -1.0f,  0.0f};
+    struct matrixFilter *p = mem_alloc(sizeof(struct matrixFilter));
+    if (!p) return NULL;
+    p->size = 3;
+    p->id = KERNEL_GENERIC;
+    p->sigma = 0.0f;
+    p->matrix = mem_alloc(9 * sizeof(float));
+    if (!p->matrix) {
+        mem_free(p);
+        return NULL;
+    }
+    memcpy(p->matrix, laplace_kernel, 9 * sizeof(float));
     return p;
 }
 
+// ===== СПЕЦИАЛИЗИРОВАННЫЕ ЯДРА =====
+
+// Свертка 3x3 с целыми весами, известными при компиляции: нулевые веса
+// исчезают, одинаковые складываются до умножения. Целочисленная сумма
+// совпадает с результатом matrix_transform бит в бит
+static uint8_t clamp_u8(int v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+#define INT_KERNEL3_CHANNEL(ch, k00, k01, k02, k10, k11, k12, k20, k21, k22)          \
+    clamp_u8((k00) * n[0].ch + (k01) * n[1].ch + (k02) * n[2].ch +                     \
+             (k10) * n[3].ch + (k11) * n[4].ch + (k12) * n[5].ch +                     \
+             (k20) * n[6].ch + (k21) * n[7].ch + (k22) * n[8].ch)
+
+#define DEFINE_INT_KERNEL3(name, k00, k01, k02, k10, k11, k12, k20, k21, k22)          \
+static struct Pixel name(int x, int y, struct BMPImage *img, void *params) {          \
+    (void)params;                                                                      \
+    int w = img->infoHeader.biWidth;                                                   \
+    int h = abs(img->infoHeader.biHeight);                                             \
+    struct Pixel n[9];                                                                 \
+    if (x > 0 && y > 0 && x < w - 1 && y < h - 1) {                                    \
+        const struct Pixel *row = img->data + (y - 1) * w + (x - 1);                   \
+        for (int i = 0; i < 3; i++, row += w) {                                        \
+            n[i * 3] = row[0]; n[i * 3 + 1] = row[1]; n[i * 3 + 2] = row[2];           \
+        }                                                                              \
+    } else {                                                                           \
+        for (int i = 0; i < 3; i++)                                                    \
+            for (int j = 0; j < 3; j++)                                                \
+                n[i * 3 + j] = checkPixel(img, x + j - 1, y + i - 1);                  \
+    }                                                                                  \
+    return (struct Pixel){INT_KERNEL3_CHANNEL(b, k00, k01, k02, k10, k11, k12, k20, k21, k22), \
+                          INT_KERNEL3_CHANNEL(g, k00, k01, k02, k10, k11, k12, k20, k21, k22), \
+                          INT_KERNEL3_CHANNEL(r, k00, k01, k02, k10, k11, k12, k20, k21, k22)}; \
+}
+
+// Свертка с размером, известным при компиляции: циклы разворачиваются,
+// порядок суммирования тот же, что у matrix_transform. Веса по-прежнему
+// читаются из params->matrix (они зависят от sigma), симметрия ядра не
+// используется - иначе float-сумма разошлась бы с эталоном
+#define DEFINE_FIXED_KERNEL(name, SIZE)                                                \
+static struct Pixel name(int x, int y, struct BMPImage *img, void *params) {          \
+    const float *m = ((struct matrixFilter *)params)->matrix;                         \
+    int w = img->infoHeader.biWidth;                                                   \
+    int h = abs(img->infoHeader.biHeight);                                             \
+    const int offset = (SIZE) / 2;                                                     \
+    int inside = x >= offset && y >= offset && x < w - offset && y < h - offset;       \
+    float newR = 0, newG = 0, newB = 0;                                                \
+    for (int i = 0; i < (SIZE); i++) {                                                 \
+        for (int j = 0; j < (SIZE); j++) {                                             \
+            struct Pixel p = inside ? img->data[(y + i - offset) * w + (x + j - offset)] \
+                                    : checkPixel(img, x + (j - offset), y + (i - offset)); \
+            float weight = m[i * (SIZE) + j];                                          \
+            newR += p.r * weight;                                                      \
+            newG += p.g * weight;                                                      \
+            newB += p.b * weight;                                                      \
+        }                                                                              \
+    }                                                                                  \
+    newR = fmaxf(0, fminf(255, newR));                                                 \
+    newG = fmaxf(0, fminf(255, newG));                                                 \
+    newB = fmaxf(0, fminf(255, newB));                                                 \
+    return (struct Pixel){(uint8_t)newB, (uint8_t)newG, (uint8_t)newR};               \
+}
+
+DEFINE_INT_KERNEL3(sharp_kernel_transform,
+                    0, -1,  0,
+                   -1,  5, -1,
+                    0, -1,  0)
+
+DEFINE_FIXED_KERNEL(gauss5_transform, 5)
+
+// Таблица специализаций: id ядра -> размер матрицы и функция
+static const struct {
+    enum KernelId id;
+    int size;
+    PixelTransform transform;
+} kernel_table[] = {
+    {KERNEL_SHARP,   3, sharp_kernel_transform},
+    {KERNEL_GAUSS_5, 5, gauss5_transform},
+};
+
+// Эталонный режим: только обобщенные реализации, для сверки быстрых путей
+static int reference_mode = 0;
+
+void set_reference_mode(int enabled) {
+    reference_mode = enabled;
+}
+
+int get_reference_mode(void) {
+    return reference_mode;
+}
+
+PixelTransform select_matrix_transform(struct matrixFilter *filter) {
+    if (!filter || reference_mode) return matrix_transform;
+    for (size_t i = 0; i < sizeof(kernel_table) / sizeof(kernel_table[0]); i++) {
+        if (kernel_table[i].id == filter->id && kernel_table[i].size == filter->size) {
+            return kernel_table[i].transform;
+        }
+    }
+    return matrix_transform;
+}
+
 struct Pixel transformer_vortex(int x, int y, struct BMPImage *img, void *params) {
     struct vortex *v = (struct vortex *)params;
     int w = img->infoHeader.biWidth;
@@ -150,6 +380,59 @@ struct Pixel transformer_crystallize(int x, int y, struct BMPImage *img, void *p
     return img->data[cy * w + cx];
 }
 
+// Точки для crystallize с синим шумом: метание дротиков с минимальным
+// расстоянием radius и сеткой ячеек radius/sqrt(2), в каждой не больше
+// одной точки, поэтому проверяются только соседние ячейки (5x5).
+// Если за отведенное число попыток точек не хватило, остаток равномерный
+void poisson_disk_points(int w, int h, int count, struct Rng *rng, int *xs, int *ys) {
+    float radius = 0.7f * sqrtf((float)w * h / count);
+    float cell = radius / sqrtf(2.0f);
+    int gw = (int)(w / cell) + 1;
+    int gh = (int)(h / cell) + 1;
+    int placed = 0;
+
+    int *grid = (radius >= 1.0f) ? mem_alloc((size_t)gw * gh * sizeof(int)) : NULL;
+    if (grid) {
+        for (int i = 0; i < gw * gh; i++) grid[i] = -1;
+
+        long long attempts = 30LL * count;
+        for (long long a = 0; a < attempts && placed < count; a++) {
+            float px = rng_float(rng) * w;
+            float py = rng_float(rng) * h;
+            int cx = (int)(px / cell);
+            int cy = (int)(py / cell);
+
+            int ok = 1;
+            for (int gy = cy - 2; gy <= cy + 2 && ok; gy++) {
+                if (gy < 0 || gy >= gh) continue;
+                for (int gx = cx - 2; gx <= cx + 2; gx++) {
+                    if (gx < 0 || gx >= gw) continue;
+                    int j = grid[gy * gw + gx];
+                    if (j < 0) continue;
+                    float dx = px - xs[j];
+                    float dy = py - ys[j];
+                    if (dx * dx + dy * dy < radius * radius) {
+                        ok = 0;
+                        break;
+                    }
+                }
+            }
+            if (!ok) continue;
+
+            xs[placed] = (int)px;
+            ys[placed] = (int)py;
+            grid[cy * gw + cx] = placed;
+            placed++;
+        }
+        mem_free(grid);
+    }
+
+    for (; placed < count; placed++) {
+        xs[placed] = (int)rng_bounded(rng, (uint32_t)w);
+        ys[placed] = (int)rng_bounded(rng, (uint32_t)h);
+    }
+}
+
 struct BMPImage* crop_image(struct BMPImage *src, void *params) {
     struct CropParams *p = (struct CropParams *)params;
     int32_t src_w = src->infoHeader.biWidth;
@@ -157,19 +440,28 @@ struct BMPImage* crop_image(struct BMPImage *src, void *params) {
 
     if (p->new_width <= 0 || p->new_height <= 0) {
         fprintf(stderr, "Ошибка: неверные размеры для crop\n");
-        return src;
+        return NULL;
     }
 
     if (p->new_width > src_w) p->new_width = src_w;
     if (p->new_height > src_h) p->new_height = src_h;
 
-    struct BMPImage *new_img = malloc(sizeof(struct BMPImage));
+    struct BMPImage *new_img = mem_alloc(sizeof(struct BMPImage));
+    if (!new_img) {
+        fprintf(stderr, "Error: cannot allocate memory for crop\n");
+        return NULL;
+    }
     memcpy(&new_img->fileHeader, &src->fileHeader, sizeof(struct BMPFileHeader));
     memcpy(&new_img->infoHeader, &src->infoHeader, sizeof(struct BMPInfoHeader));
 
     new_img->infoHeader.biWidth = p->new_width;
     new_img->infoHeader.biHeight = (src->infoHeader.biHeight < 0) ? -p->new_height : p->new_height;
-    new_img->data = malloc(p->new_width * p->new_height * sizeof(struct Pixel));
+    new_img->data = mem_alloc((size_t)p->new_width * p->new_height * sizeof(struct Pixel));
+    if (!new_img->data) {
+        fprintf(stderr, "Error: cannot allocate memory for crop\n");
+        mem_free(new_img);
+        return NULL;
+    }
 
     for (int y = 0; y < p->new_height; y++) {
         for (int x = 0; x < p->new_width; x++) {
@@ -198,9 +490,10 @@ struct Pixel transformer_median(int x, int y, struct BMPImage *img, void *params
         return img->data[y * img->infoHeader.biWidth + x];
     }
 
-    uint8_t *r_values = malloc(total_pixels * sizeof(uint8_t));
-    uint8_t *g_values = malloc(total_pixels * sizeof(uint8_t));
-    uint8_t *b_values = malloc(total_pixels * sizeof(uint8_t));
+    // Буфер выделен один раз на фильтр (create_median_params), а не на каждый пиксель
+    uint8_t *r_values = p->values;
+    uint8_t *g_values = p->values + total_pixels;
+    uint8_t *b_values = p->values + 2 * total_pixels;
 
     int count = 0;
     for (int ky = 0; ky < size; ky++) {
@@ -222,11 +515,21 @@ struct Pixel transformer_median(int x, int y, struct BMPImage *img, void *params
         g_values[total_pixels / 2],
         r_values[total_pixels / 2]
     };
-
-    free(r_values); free(g_values); free(b_values);
     return result;
 }
 
+struct MedianParams *create_median_params(int window_size) {
+    struct MedianParams *p = mem_alloc(sizeof(struct MedianParams));
+    if (!p) return NULL;
+    p->window_size = window_size;
+    p->values = mem_alloc(3 * (size_t)window_size * window_size);
+    if (!p->values) {
+        mem_free(p);
+        return NULL;
+    }
+    return p;
+}
+
 struct Pixel shift_transform(int x, int y, struct BMPImage *img, void *params) {
     struct formulaFilter *f = (struct formulaFilter *)params;
     struct Pixel p = img->data[y * img->infoHeader.biWidth + x];
@@ -249,46 +552,741 @@ struct Pixel threshold_transform(int x, int y, struct BMPImage *img, void *param
     return (struct Pixel){color, color, color};
 }
 
+// ===== ПОТОКИ =====
+
+static int filter_threads = 1;
+
+void set_filter_threads(int threads) {
+    filter_threads = (threads < 1) ? 1 : threads;
+}
+
+int get_filter_threads(void) {
+    return filter_threads;
+}
+
+struct BandTask {
+    BandWorker worker;
+    void *ctx;
+    int y_begin;
+    int y_end;
+};
+
+static void *band_thread(void *arg) {
+    struct BandTask *task = (struct BandTask *)arg;
+    task->worker(task->y_begin, task->y_end, task->ctx);
+    return NULL;
+}
+
+// Делит строки [0, h) на полосы и обрабатывает их в filter_threads потоках.
+// Если потоки создать не удалось, полоса обрабатывается в текущем потоке
+void run_bands(int h, BandWorker worker, void *ctx) {
+    int threads = filter_threads;
+    if (threads > h) threads = h;
+    if (threads <= 1) {
+        worker(0, h, ctx);
+        return;
+    }
+
+    pthread_t *ids = mem_alloc(threads * sizeof(pthread_t));
+    struct BandTask *tasks = mem_alloc(threads * sizeof(struct BandTask));
+    int *started = mem_calloc(threads, sizeof(int));
+    if (!ids || !tasks || !started) {
+        mem_free(ids); mem_free(tasks); mem_free(started);
+        worker(0, h, ctx);
+        return;
+    }
+
+    for (int t = 0; t < threads; t++) {
+        tasks[t].worker = worker;
+        tasks[t].ctx = ctx;
+        tasks[t].y_begin = (int)((long long)h * t / threads);
+        tasks[t].y_end = (int)((long long)h * (t + 1) / threads);
+        if (t > 0) {
+            started[t] = pthread_create(&ids[t], NULL, band_thread, &tasks[t]) == 0;
+        }
+    }
+    // Первая полоса - в текущем потоке, а также те, для которых поток не создался
+    for (int t = 0; t < threads; t++) {
+        if (!started[t]) worker(tasks[t].y_begin, tasks[t].y_end, ctx);
+    }
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) pthread_join(ids[t], NULL);
+    }
+
+    mem_free(ids); mem_free(tasks); mem_free(started);
+}
+
+// ===== ВЫДЕЛЕНИЕ ГРАНИЦ =====
+
+struct EdgeContext {
+    struct BMPImage *img;
+    struct Pixel *out;
+    struct EdgeDetectParams *params;
+    atomic_int failed;
+};
+
+// Яркость строки - те же коэффициенты и округление, что у -gs
+static void luma_row(const struct Pixel *row, uint8_t *luma, int w) {
+    for (int x = 0; x < w; x++) {
+        float res = 0.299f * row[x].r + 0.587f * row[x].g + 0.114f * row[x].b;
+        if (res < 0) res = 0;
+        if (res > 255) res = 255;
+        luma[x] = (uint8_t)res;
+    }
+}
+
+static void edge_band(int y_begin, int y_end, void *arg) {
+    struct EdgeContext *ctx = (struct EdgeContext *)arg;
+    int w = ctx->img->infoHeader.biWidth;
+    int h = abs(ctx->img->infoHeader.biHeight);
+    int threshold = ctx->params->threshold;
+    int automatic = ctx->params->auto_threshold;
+    // Модуль и Лапласиан ограничены 255: так порог можно возводить в квадрат
+    if (threshold > 255) threshold = 255;
+    if (threshold < -1) threshold = -1;
+
+    // Скользящий буфер из трех строк яркости: выше, текущая, ниже
+    uint8_t *buffer = mem_alloc(3 * w);
+    if (!buffer) {
+        atomic_store(&ctx->failed, 1);
+        return;
+    }
+    uint8_t *above = buffer, *center = buffer + w, *below = buffer + 2 * w;
+    luma_row(ctx->img->data + clamp_index(y_begin - 1, h) * w, above, w);
+    luma_row(ctx->img->data + y_begin * w, center, w);
+
+    for (int y = y_begin; y < y_end; y++) {
+        luma_row(ctx->img->data + clamp_index(y + 1, h) * w, below, w);
+        struct Pixel *out = ctx->out + y * w;
+
+        for (int x = 0; x < w; x++) {
+            int xl = (x > 0) ? x - 1 : 0;
+            int xr = (x < w - 1) ? x + 1 : w - 1;
+            int edge, response;
+            if (ctx->params->op == EDGE_SOBEL) {
+                int gx = (above[xr] + 2 * center[xr] + below[xr]) -
+                         (above[xl] + 2 * center[xl] + below[xl]);
+                int gy = (below[xl] + 2 * below[x] + below[xr]) -
+                         (above[xl] + 2 * above[x] + above[xr]);
+                // |g| > t  <=>  |g|^2 > t^2, модуль ограничен 255
+                int mag_sq = gx * gx + gy * gy;
+                if (mag_sq > 255 * 255) mag_sq = 255 * 255;
+                edge = (threshold < 0) || mag_sq > threshold * threshold;
+                response = (int)sqrtf((float)mag_sq);
+            } else {
+                int lap = 4 * center[x] - above[x] - below[x] - center[xl] - center[xr];
+                if (lap < 0) lap = 0;
+                if (lap > 255) lap = 255;
+                edge = lap > threshold;
+                response = lap;
+            }
+            // Для автоматического порога сначала сохраняем сам отклик
+            uint8_t color = automatic ? (uint8_t)response : (edge ? 255 : 0);
+            out[x] = (struct Pixel){color, color, color};
+        }
+
+        uint8_t *tmp = above;
+        above = center;
+        center = below;
+        below = tmp;
+    }
+
+    mem_free(buffer);
+}
+
+struct ThresholdContext {
+    struct Pixel *data;
+    int w;
+    int threshold;
+};
+
+static void threshold_band(int y_begin, int y_end, void *arg) {
+    struct ThresholdContext *ctx = (struct ThresholdContext *)arg;
+    struct Pixel *p = ctx->data + (size_t)y_begin * ctx->w;
+    struct Pixel *end = ctx->data + (size_t)y_end * ctx->w;
+    for (; p < end; p++) {
+        uint8_t color = (p->r > ctx->threshold) ? 255 : 0;
+        *p = (struct Pixel){color, color, color};
+    }
+}
+
+// Порог Оцу по гистограмме отклика, затем бинаризация
+static int apply_auto_threshold(struct Pixel *data, int w, int h) {
+    struct BMPImage view;
+    view.infoHeader.biWidth = w;
+    view.infoHeader.biHeight = h;
+    view.data = data;
+
+    struct ImageStats stats;
+    if (compute_image_stats(&view, &stats) != 0) {
+        fprintf(stderr, "Error: cannot compute edge threshold\n");
+        return -1;
+    }
+    struct ThresholdContext ctx = {data, w, otsu_threshold(stats.histogram[STATS_RED])};
+    printf("  Edge threshold (Otsu): %d\n", ctx.threshold);
+    run_bands(h, threshold_band, &ctx);
+    return 0;
+}
+
+struct BMPImage* edge_detect(struct BMPImage *img, void *params) {
+    int w = img->infoHeader.biWidth;
+    int h = abs(img->infoHeader.biHeight);
+    size_t bytes = (size_t)w * h * sizeof(struct Pixel);
+
+    struct EdgeContext ctx;
+    ctx.img = img;
+    ctx.params = (struct EdgeDetectParams *)params;
+    atomic_init(&ctx.failed, 0);
+
+    // Строка y перезаписывается только после того, как прочитана строка y+1,
+    // поэтому в одном потоке можно писать прямо в исходные данные
+    if (mem_would_exceed(bytes)) {
+        ctx.out = img->data;
+        edge_band(0, h, &ctx);
+        if (atomic_load(&ctx.failed)) {
+            fprintf(stderr, "Error: cannot allocate memory for edge detection\n");
+            return NULL;
+        }
+        if (ctx.params->auto_threshold && apply_auto_threshold(img->data, w, h) != 0) return NULL;
+        return img;
+    }
+
+    ctx.out = mem_alloc(bytes);
+    if (!ctx.out) {
+        fprintf(stderr, "Error: cannot allocate memory for edge detection\n");
+        return NULL;
+    }
+    run_bands(h, edge_band, &ctx);
+
+    if (atomic_load(&ctx.failed)) {
+        fprintf(stderr, "Error: cannot allocate memory for edge detection\n");
+        mem_free(ctx.out);
+        return NULL;
+    }
+
+    if (ctx.params->auto_threshold && apply_auto_threshold(ctx.out, w, h) != 0) {
+        mem_free(ctx.out);
+        return NULL;
+    }
+    mem_free(img->data);
+    img->data = ctx.out;
+    return img;
+}
+
+// ===== BOX / STACK BLUR =====
+
+// Box blur одной строки/столбца: line - копия исходных пикселей,
+// результат пишется в dst с шагом stride. Окно сдвигается на один пиксель:
+// добавляем входящий пиксель, вычитаем уходящий
+static void box_blur_line(const struct Pixel *line, struct Pixel *dst, int n, int stride, int r) {
+    int div = 2 * r + 1;
+    int sr = 0, sg = 0, sb = 0;
+    for (int i = -r; i <= r; i++) {
+        struct Pixel p = line[clamp_index(i, n)];
+        sr += p.r; sg += p.g; sb += p.b;
+    }
+    for (int i = 0; i < n; i++) {
+        dst[i * stride] = (struct Pixel){(uint8_t)((sb + div / 2) / div),
+                                         (uint8_t)((sg + div / 2) / div),
+                                         (uint8_t)((sr + div / 2) / div)};
+        struct Pixel in = line[clamp_index(i + r + 1, n)];
+        struct Pixel out = line[clamp_index(i - r, n)];
+        sr += in.r - out.r;
+        sg += in.g - out.g;
+        sb += in.b - out.b;
+    }
+}
+
+// Stack blur одной строки/столбца: треугольные веса r+1-|i|.
+// sum_in - пиксели справа (войдут с большим весом), sum_out - центр и левее.
+// Взвешенная сумма достигает 255 * (r+1)^2 и для больших r не помещается в int
+static void stack_blur_line(const struct Pixel *line, struct Pixel *dst, int n, int stride, int r) {
+    int64_t div = (int64_t)(r + 1) * (r + 1);
+    int64_t sr = 0, sg = 0, sb = 0;
+    int64_t in_r = 0, in_g = 0, in_b = 0;
+    int64_t out_r = 0, out_g = 0, out_b = 0;
+
+    for (int i = -r; i <= r; i++) {
+        struct Pixel p = line[clamp_index(i, n)];
+        int64_t weight = r + 1 - abs(i);
+        sr += p.r * weight; sg += p.g * weight; sb += p.b * weight;
+        if (i <= 0) {
+            out_r += p.r; out_g += p.g; out_b += p.b;
+        }
+    }
+    for (int i = 1; i <= r + 1; i++) {
+        struct Pixel p = line[clamp_index(i, n)];
+        in_r += p.r; in_g += p.g; in_b += p.b;
+    }
+
+    for (int i = 0; i < n; i++) {
+        dst[i * stride] = (struct Pixel){(uint8_t)((sb + div / 2) / div),
+                                         (uint8_t)((sg + div / 2) / div),
+                                         (uint8_t)((sr + div / 2) / div)};
+        sr += in_r - out_r;
+        sg += in_g - out_g;
+        sb += in_b - out_b;
+
+        struct Pixel next = line[clamp_index(i + 1, n)];
+        struct Pixel leaving = line[clamp_index(i - r, n)];
+        struct Pixel entering = line[clamp_index(i + r + 2, n)];
+        out_r += next.r - leaving.r;
+        out_g += next.g - leaving.g;
+        out_b += next.b - leaving.b;
+        in_r += entering.r - next.r;
+        in_g += entering.g - next.g;
+        in_b += entering.b - next.b;
+    }
+}
+
+typedef void (*BlurLine)(const struct Pixel *line, struct Pixel *dst, int n, int stride, int r);
+
+// Раздельное размытие: сначала строки, затем столбцы, для каждого прохода
+static struct BMPImage* separable_blur(struct BMPImage *img, struct BlurParams *p, BlurLine blur_line) {
+    int w = img->infoHeader.biWidth;
+    int h = abs(img->infoHeader.biHeight);
+    struct Pixel *line = mem_alloc((w > h ? w : h) * sizeof(struct Pixel));
+    if (!line) {
+        fprintf(stderr, "Error: cannot allocate memory for blur\n");
+        return NULL;
+    }
+
+    for (int pass = 0; pass < p->passes; pass++) {
+        int r = p->radius[pass];
+        if (r <= 0) continue;
+        for (int y = 0; y < h; y++) {
+            struct Pixel *row = img->data + y * w;
+            memcpy(line, row, w * sizeof(struct Pixel));
+            blur_line(line, row, w, 1, r);
+        }
+        for (int x = 0; x < w; x++) {
+            for (int y = 0; y < h; y++) {
+                line[y] = img->data[y * w + x];
+            }
+            blur_line(line, img->data + x, h, w, r);
+        }
+    }
+
+    mem_free(line);
+    return img;
+}
+
+struct BMPImage* box_blur(struct BMPImage *img, void *params) {
+    return separable_blur(img, (struct BlurParams *)params, box_blur_line);
+}
+
+struct BMPImage* stack_blur(struct BMPImage *img, void *params) {
+    return separable_blur(img, (struct BlurParams *)params, stack_blur_line);
+}
+
+struct BlurParams *create_box_blur_params(int radius) {
+    struct BlurParams *p = mem_alloc(sizeof(struct BlurParams));
+    if (!p) return NULL;
+    p->passes = 1;
+    p->radius[0] = radius;
+    return p;
+}
+
+// Несколько последовательных box blur дают приближение Гаусса
+// (размеры окон подбираются так, чтобы суммарная дисперсия была sigma^2)
+struct BlurParams *create_gauss_box_params(float sigma, int passes) {
+    if (passes < 1) passes = 1;
+    if (passes > BLUR_MAX_PASSES) passes = BLUR_MAX_PASSES;
+
+    struct BlurParams *p = mem_alloc(sizeof(struct BlurParams));
+    if (!p) return NULL;
+    p->passes = passes;
+
+    float ideal = sqrtf(12.0f * sigma * sigma / passes + 1.0f);
+    int wl = (int)floorf(ideal);
+    if (wl % 2 == 0) wl--;
+    int wu = wl + 2;
+    float m_ideal = (12.0f * sigma * sigma - passes * wl * wl - 4.0f * passes * wl - 3.0f * passes) /
+                    (-4.0f * wl - 4.0f);
+    int m = (int)roundf(m_ideal);
+
+    for (int i = 0; i < passes; i++) {
+        int size = (i < m) ? wl : wu;
+        p->radius[i] = (size - 1) / 2;
+    }
+    return p;
+}
+
+// ===== МОРФОЛОГИЯ =====
+
+// Буферы для одной линии: дополненная копия и префиксные/суффиксные экстремумы
+struct MorphBuffers {
+    uint8_t *pad;
+    uint8_t *g;
+    uint8_t *h;
+};
+
+// Минимум/максимум по окну длины k (van Herk/Gil-Werman).
+// Линия дополняется нейтральным значением до длины, кратной k; внутри каждого
+// блока из k элементов g - максимум от начала блока, h - до конца блока.
+// Окно [i, i+k) пересекает не больше двух блоков: результат = max(h[i], g[i+k-1])
+static void morph_line(uint8_t *line, int n, int stride, int k, int is_max, struct MorphBuffers *b) {
+    int anchor = k / 2;
+    int len = ((n + k - 1 + k - 1) / k) * k;
+    uint8_t neutral = is_max ? 0 : 255;
+
+    for (int j = 0; j < len; j++) {
+        int src = j - anchor;
+        b->pad[j] = (src >= 0 && src < n) ? line[src * stride] : neutral;
+    }
+
+    for (int start = 0; start < len; start += k) {
+        int end = start + k - 1;
+        b->g[start] = b->pad[start];
+        for (int j = start + 1; j <= end; j++) {
+            uint8_t v = b->pad[j];
+            b->g[j] = is_max ? (v > b->g[j - 1] ? v : b->g[j - 1])
+                             : (v < b->g[j - 1] ? v : b->g[j - 1]);
+        }
+        b->h[end] = b->pad[end];
+        for (int j = end - 1; j >= start; j--) {
+            uint8_t v = b->pad[j];
+            b->h[j] = is_max ? (v > b->h[j + 1] ? v : b->h[j + 1])
+                             : (v < b->h[j + 1] ? v : b->h[j + 1]);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        uint8_t a = b->h[i];
+        uint8_t c = b->g[i + k - 1];
+        line[i * stride] = is_max ? (a > c ? a : c) : (a < c ? a : c);
+    }
+}
+
+// Раздельная морфология по плоскости из channels чередующихся каналов
+static void morph_plane(uint8_t *plane, int w, int h, int channels,
+                        struct MorphParams *p, int is_max, struct MorphBuffers *b) {
+    for (int c = 0; c < channels; c++) {
+        if (p->width > 1) {
+            for (int y = 0; y < h; y++) {
+                morph_line(plane + (size_t)y * w * channels + c, w, channels, p->width, is_max, b);
+            }
+        }
+        if (p->height > 1) {
+            for (int x = 0; x < w; x++) {
+                morph_line(plane + (size_t)x * channels + c, h, w * channels, p->height, is_max, b);
+            }
+        }
+    }
+}
+
+static int is_grayscale(struct BMPImage *img, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        struct Pixel p = img->data[i];
+        if (p.r != p.g || p.g != p.b) return 0;
+    }
+    return 1;
+}
+
+static struct BMPImage* morph_apply(struct BMPImage *img, struct MorphParams *p, int is_max) {
+    int w = img->infoHeader.biWidth;
+    int h = abs(img->infoHeader.biHeight);
+    size_t count = (size_t)w * h;
+    int longest = (w > h ? w : h) + 2 * ((p->width > p->height) ? p->width : p->height);
+
+    struct MorphBuffers b;
+    b.pad = mem_alloc(longest);
+    b.g = mem_alloc(longest);
+    b.h = mem_alloc(longest);
+    if (!b.pad || !b.g || !b.h) {
+        fprintf(stderr, "Error: cannot allocate memory for morphology\n");
+        mem_free(b.pad); mem_free(b.g); mem_free(b.h);
+        return NULL;
+    }
+
+    // Для полутонового изображения (например, после -edge) хватает одного канала
+    uint8_t *gray = is_grayscale(img, count) ? mem_alloc(count) : NULL;
+    if (gray) {
+        for (size_t i = 0; i < count; i++) gray[i] = img->data[i].r;
+        morph_plane(gray, w, h, 1, p, is_max, &b);
+        for (size_t i = 0; i < count; i++) {
+            img->data[i] = (struct Pixel){gray[i], gray[i], gray[i]};
+        }
+        mem_free(gray);
+    } else {
+        // struct Pixel упакована, поэтому данные - это плоскость BGR-байтов
+        morph_plane((uint8_t *)img->data, w, h, 3, p, is_max, &b);
+    }
+
+    mem_free(b.pad); mem_free(b.g); mem_free(b.h);
+    return img;
+}
+
+struct BMPImage* erode_image(struct BMPImage *img, void *params) {
+    return morph_apply(img, (struct MorphParams *)params, 0);
+}
+
+struct BMPImage* dilate_image(struct BMPImage *img, void *params) {
+    return morph_apply(img, (struct MorphParams *)params, 1);
+}
+
+struct BMPImage* open_image(struct BMPImage *img, void *params) {
+    if (!erode_image(img, params)) return NULL;
+    return dilate_image(img, params);
+}
+
+struct BMPImage* close_image(struct BMPImage *img, void *params) {
+    if (!dilate_image(img, params)) return NULL;
+    return erode_image(img, params);
+}
+
+// ===== УМЕНЬШЕНИЕ =====
+
+// Одна строка уменьшения: блоки 2x2 из строк r0 и r1 -> full пикселей o.
+// Скалярный вариант - эталон и хвост строки для SSE2
+static void downscale_row_scalar(const uint8_t *r0, const uint8_t *r1, uint8_t *o, int x, int full) {
+    for (; x < full; x++) {
+        for (int c = 0; c < 3; c++) {
+            int sum = r0[6 * x + c] + r0[6 * x + 3 + c] + r1[6 * x + c] + r1[6 * x + 3 + c];
+            o[3 * x + c] = (uint8_t)((sum + 2) >> 2);
+        }
+    }
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+// 4 выходных пикселя за шаг: 24 байта из каждой строки расширяются до 16 бит
+// и складываются по вертикали, затем каждый байт складывается с байтом того же
+// канала соседнего пикселя (сдвиг на 3 элемента). Нужные суммы лежат в
+// элементах 0-2, 6-8, 12-14, 18-20 - они записываются перекрывающимися
+// 4-байтными записями (лишний байт затирает следующая)
+static void downscale_row(const uint8_t *r0, const uint8_t *r1, uint8_t *o, int w, int full) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    int x = 0;
+    // Читаем 32 байта от 6x, поэтому последние пиксели строки - скалярно
+    for (; x + 4 <= full && 6 * x + 32 <= 3 * w; x += 4) {
+        __m128i a_lo = _mm_loadu_si128((const __m128i *)(r0 + 6 * x));
+        __m128i a_hi = _mm_loadu_si128((const __m128i *)(r0 + 6 * x + 16));
+        __m128i b_lo = _mm_loadu_si128((const __m128i *)(r1 + 6 * x));
+        __m128i b_hi = _mm_loadu_si128((const __m128i *)(r1 + 6 * x + 16));
+        __m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a_lo, zero), _mm_unpacklo_epi8(b_lo, zero));
+        __m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a_lo, zero), _mm_unpackhi_epi8(b_lo, zero));
+        __m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(a_hi, zero), _mm_unpacklo_epi8(b_hi, zero));
+
+        __m128i h0 = _mm_add_epi16(v0, _mm_or_si128(_mm_srli_si128(v0, 6), _mm_slli_si128(v1, 10)));
+        __m128i h1 = _mm_add_epi16(v1, _mm_or_si128(_mm_srli_si128(v1, 6), _mm_slli_si128(v2, 10)));
+        __m128i h2 = _mm_add_epi16(v2, _mm_srli_si128(v2, 6));
+        h0 = _mm_srli_epi16(_mm_add_epi16(h0, two), 2);
+        h1 = _mm_srli_epi16(_mm_add_epi16(h1, two), 2);
+        h2 = _mm_srli_epi16(_mm_add_epi16(h2, two), 2);
+
+        __m128i p = _mm_packus_epi16(h0, h1);
+        __m128i q = _mm_packus_epi16(h2, h2);
+        uint8_t *d = o + 3 * x;
+        int32_t v;
+        v = _mm_cvtsi128_si32(p);
+        memcpy(d, &v, 4);
+        v = _mm_cvtsi128_si32(_mm_srli_si128(p, 6));
+        memcpy(d + 3, &v, 4);
+        v = _mm_cvtsi128_si32(_mm_srli_si128(p, 12));
+        memcpy(d + 6, &v, 4);
+        v = _mm_cvtsi128_si32(_mm_srli_si128(q, 2));
+        memcpy(d + 9, &v, 3);
+    }
+    downscale_row_scalar(r0, r1, o, x, full);
+}
+#else
+static void downscale_row(const uint8_t *r0, const uint8_t *r1, uint8_t *o, int w, int full) {
+    (void)w;
+    downscale_row_scalar(r0, r1, o, 0, full);
+}
+#endif
+
+// Уменьшение в 2 раза усреднением блоков 2x2 (на нечетных краях
+// повторяется последняя строка/столбец). На x86 строки обрабатываются SSE2,
+// в эталонном режиме и на других платформах - скалярно
+struct BMPImage* downscale_2x(struct BMPImage *src) {
+    int w = src->infoHeader.biWidth;
+    int h = abs(src->infoHeader.biHeight);
+    int nw = (w + 1) / 2;
+    int nh = (h + 1) / 2;
+
+    struct BMPImage *dst = mem_alloc(sizeof(struct BMPImage));
+    if (!dst) return NULL;
+    dst->data = mem_alloc((size_t)nw * nh * sizeof(struct Pixel));
+    if (!dst->data) {
+        mem_free(dst);
+        return NULL;
+    }
+    memcpy(&dst->fileHeader, &src->fileHeader, sizeof(struct BMPFileHeader));
+    memcpy(&dst->infoHeader, &src->infoHeader, sizeof(struct BMPInfoHeader));
+    dst->infoHeader.biWidth = nw;
+    dst->infoHeader.biHeight = (src->infoHeader.biHeight < 0) ? -nh : nh;
+
+    const uint8_t *bytes = (const uint8_t *)src->data;
+    uint8_t *out = (uint8_t *)dst->data;
+    int full = w / 2;   // столбцы, для которых есть полный блок 2x2
+
+    for (int y = 0; y < nh; y++) {
+        const uint8_t *r0 = bytes + (size_t)(2 * y) * w * 3;
+        const uint8_t *r1 = bytes + (size_t)clamp_index(2 * y + 1, h) * w * 3;
+        uint8_t *o = out + (size_t)y * nw * 3;
+        if (reference_mode) downscale_row_scalar(r0, r1, o, 0, full);
+        else downscale_row(r0, r1, o, w, full);
+        if (full < nw) {
+            for (int c = 0; c < 3; c++) {
+                int sum = r0[6 * full + c] + r1[6 * full + c];
+                o[3 * full + c] = (uint8_t)((sum + 1) >> 1);
+            }
+        }
+    }
+
+    return dst;
+}
+
+// Пирамида: levels[0] = src, levels[i] = levels[i-1] уменьшенный в 2 раза.
+// Уровни создаются, пока длинная сторона больше min_dim, но не больше max_levels.
+// NULL, если не хватило памяти
+struct BMPImage** build_pyramid(struct BMPImage *src, int max_levels, int min_dim, int *count) {
+    struct BMPImage **levels = mem_alloc(max_levels * sizeof(struct BMPImage *));
+    if (!levels) return NULL;
+    levels[0] = src;
+    *count = 1;
+
+    while (*count < max_levels) {
+        struct BMPImage *prev = levels[*count - 1];
+        int w = prev->infoHeader.biWidth;
+        int h = abs(prev->infoHeader.biHeight);
+        if ((w > h ? w : h) <= min_dim) break;
+
+        struct BMPImage *next = downscale_2x(prev);
+        if (!next) {
+            free_pyramid(levels, *count);
+            return NULL;
+        }
+        levels[(*count)++] = next;
+    }
+    return levels;
+}
+
+void free_pyramid(struct BMPImage **levels, int count) {
+    if (!levels) return;
+    // levels[0] - исходное изображение, им владеет вызывающий код
+    for (int i = 1; i < count; i++) free_bmp(levels[i]);
+    mem_free(levels);
+}
+
+// ===== МАСШТАБИРОВАНИЕ ПАРАМЕТРОВ =====
+// Для режима -preview: параметры, заданные в пикселях исходного
+// изображения, пересчитываются для уменьшенного в 1/factor раз
+
+static int scale_length(int value, float factor, int min_value) {
+    int scaled = (int)lroundf(value * factor);
+    return scaled < min_value ? min_value : scaled;
+}
+
+void scale_matrix_filter(void *ptr, float factor) {
+    struct matrixFilter *f = (struct matrixFilter *)ptr;
+    // Масштабировать можно только ядро Гаусса
+    if (f->sigma > 0) fill_gauss_matrix(f, f->sigma * factor);
+}
+
+void scale_median_params(void *ptr, float factor) {
+    struct MedianParams *p = (struct MedianParams *)ptr;
+    int size = scale_length(p->window_size, factor, 3);
+    if (size % 2 == 0) size++;
+    // Буфер values рассчитан на исходное окно
+    if (size < p->window_size) p->window_size = size;
+}
+
+void scale_vortex_params(void *ptr, float factor) {
+    struct vortex *v = (struct vortex *)ptr;
+    v->radius *= factor;
+}
+
+void scale_crystal_params(void *ptr, float factor) {
+    struct CrystalParams *p = (struct CrystalParams *)ptr;
+    for (int i = 0; i < p->points_count; i++) {
+        p->coords_x[i] = (int)(p->coords_x[i] * factor);
+        p->coords_y[i] = (int)(p->coords_y[i] * factor);
+    }
+}
+
+void scale_crop_params(void *ptr, float factor) {
+    struct CropParams *p = (struct CropParams *)ptr;
+    p->new_width = scale_length(p->new_width, factor, 1);
+    p->new_height = scale_length(p->new_height, factor, 1);
+}
+
+void scale_blur_params(void *ptr, float factor) {
+    struct BlurParams *p = (struct BlurParams *)ptr;
+    for (int i = 0; i < p->passes; i++) {
+        p->radius[i] = scale_length(p->radius[i], factor, 0);
+    }
+}
+
+void scale_morph_params(void *ptr, float factor) {
+    struct MorphParams *p = (struct MorphParams *)ptr;
+    p->width = scale_length(p->width, factor, 1);
+    p->height = scale_length(p->height, factor, 1);
+}
+
+struct BMPImage* print_hash_filter(struct BMPImage *img, void *params) {
+    (void)params;
+    printf("  Hash: %016llx\n", (unsigned long long)image_hash(img));
+    return img;
+}
+
 // ===== ДЕСТРУКТОРЫ =====
 
 void destroy_matrix_filter(void *ptr) {
     struct matrixFilter *f = (struct matrixFilter *)ptr;
     if (f) {
-        if (f->matrix) free(f->matrix);
-        free(f);
+        if (f->matrix) mem_free(f->matrix);
+        mem_free(f);
     }
 }
 
 void destroy_formula_filter(void *ptr) {
     struct formulaFilter *f = (struct formulaFilter *)ptr;
-    if (f) free(f);
+    if (f) mem_free(f);
 }
 
 void destroy_vortex_params(void *ptr) {
     struct vortex *v = (struct vortex *)ptr;
-    if (v) free(v);
+    if (v) mem_free(v);
 }
 
 void destroy_crystal_params(void *ptr) {
     struct CrystalParams *p = (struct CrystalParams *)ptr;
     if (p) {
-        if (p->coords_x) free(p->coords_x);
-        if (p->coords_y) free(p->coords_y);
-        free(p);
+        if (p->coords_x) mem_free(p->coords_x);
+        if (p->coords_y) mem_free(p->coords_y);
+        mem_free(p);
     }
 }
 
 void destroy_crop_params(void *ptr) {
     struct CropParams *p = (struct CropParams *)ptr;
-    if (p) free(p);
+    if (p) mem_free(p);
 }
 
 void destroy_median_params(void *ptr) {
     struct MedianParams *p = (struct MedianParams *)ptr;
-    if (p) free(p);
+    if (p) {
+        mem_free(p->values);
+        mem_free(p);
+    }
 }
 
 void destroy_edge_params(void *ptr) {
     struct EdgeDetectParams *e = (struct EdgeDetectParams *)ptr;
-    if (e) free(e);
+    if (e) mem_free(e);
+}
+
+void destroy_blur_params(void *ptr) {
+    struct BlurParams *p = (struct BlurParams *)ptr;
+    if (p) mem_free(p);
+}
+
+void destroy_morph_params(void *ptr) {
+    struct MorphParams *p = (struct MorphParams *)ptr;
+    if (p) mem_free(p);
 }
\ No newline at end of file
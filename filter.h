@@ -2,11 +2,21 @@
 #define LABIP_FILTER_H
 
 #include "bmpreader.h"
+#include "rng.h"
 #include <time.h>
 //1
+// Встроенные ядра, для которых есть специализированные свертки
+enum KernelId {
+    KERNEL_GENERIC,     // произвольная матрица
+    KERNEL_SHARP,       // резкость 3x3
+    KERNEL_GAUSS_5      // Гаусс 5x5 (радиус 2), -blur
+};
+
 struct matrixFilter {
     int size;
     float *matrix;
+    enum KernelId id;
+    float sigma;        // для ядер Гаусса, иначе 0
 };
 
 struct formulaFilter {
@@ -15,6 +25,24 @@ struct formulaFilter {
 
 typedef struct Pixel (*PixelTransform)(int x, int y, struct BMPImage *img, void *params);
 typedef void (*ParamsDestructor)(void *params);
+typedef void (*ParamsScaler)(void *params, float factor);  // пересчет под другой масштаб
+
+// Какие исходные пиксели читает преобразование для результата (x, y)
+enum PixelAccess {
+    ACCESS_POINT,           // только (x, y) - можно на месте
+    ACCESS_NEIGHBORHOOD,    // строки y-radius..y+radius - скользящее окно строк
+    ACCESS_GEOMETRIC        // произвольные пиксели - нужна полная копия
+};
+
+struct AccessPattern {
+    enum PixelAccess kind;
+    int radius;
+};
+
+// Доступ объявляет тот, кто добавляет преобразование; radius - верхняя граница
+#define POINT_ACCESS ((struct AccessPattern){ACCESS_POINT, 0})
+#define NEIGHBORHOOD_ACCESS(r) ((struct AccessPattern){ACCESS_NEIGHBORHOOD, (r)})
+#define GEOMETRIC_ACCESS ((struct AccessPattern){ACCESS_GEOMETRIC, 0})
 
 struct vortex {
     float angle;
@@ -34,10 +62,32 @@ struct CropParams {
 
 struct MedianParams {
     int window_size;
+    uint8_t *values;    // 3 * window_size^2 байт: значения r, g, b окна
+};
+
+enum EdgeOperator {
+    EDGE_LAPLACE,   // Лапласиан 3x3 (4-связный)
+    EDGE_SOBEL      // модуль градиента Собеля
 };
 
 struct EdgeDetectParams {
     int threshold;
+    enum EdgeOperator op;   // используется только edge_detect
+    int auto_threshold;     // 1 - порог выбирается методом Оцу
+};
+
+// Прямоугольный структурный элемент для морфологии
+struct MorphParams {
+    int width;
+    int height;
+};
+
+#define BLUR_MAX_PASSES 3
+
+// Параметры box/stack blur: радиус окна для каждого прохода
+struct BlurParams {
+    int passes;
+    int radius[BLUR_MAX_PASSES];
 };
 #if 0
 struct FilterNode {
@@ -58,17 +108,66 @@ void destroy_crystal_params(void *p);
 void destroy_crop_params(void *p);
 void destroy_median_params(void *p);
 void destroy_edge_params(void *e);
+void destroy_blur_params(void *p);
+void destroy_morph_params(void *p);
+
+// Масштабирование параметров (режим -preview)
+void scale_matrix_filter(void *f, float factor);
+void scale_median_params(void *p, float factor);
+void scale_vortex_params(void *v, float factor);
+void scale_crystal_params(void *p, float factor);
+void scale_crop_params(void *p, float factor);
+void scale_blur_params(void *p, float factor);
+void scale_morph_params(void *p, float factor);
 
 // Основные функции
-void apply_transform(struct BMPImage *img, PixelTransform transform, void* params);
+int apply_transform(struct BMPImage *img, PixelTransform transform, void* params,
+                    struct AccessPattern access);
 struct Pixel formula_transform(int x, int y, struct BMPImage *img, void *params);
 struct Pixel matrix_transform(int x, int y, struct BMPImage *img, void *params);
 struct matrixFilter *create_gauss_kernel(int radius, float sigma);
+struct matrixFilter *create_sharp_kernel(void);
+struct matrixFilter *create_laplace_kernel(void);
+PixelTransform select_matrix_transform(struct matrixFilter *filter);  // специализация по id ядра
+void set_reference_mode(int enabled);   // 1 - без специализаций и слияния проходов
+int get_reference_mode(void);
 struct Pixel transformer_vortex(int x, int y, struct BMPImage *img, void *params);
 struct Pixel transformer_crystallize(int x, int y, struct BMPImage *img, void *params);
+void poisson_disk_points(int w, int h, int count, struct Rng *rng, int *xs, int *ys);
 struct BMPImage* crop_image(struct BMPImage *src, void *params);
 struct Pixel transformer_median(int x, int y, struct BMPImage *img, void *params);
+struct MedianParams *create_median_params(int window_size);
 struct Pixel shift_transform(int x, int y, struct BMPImage *img, void *params);
 struct Pixel threshold_transform(int x, int y, struct BMPImage *img, void *params);
 
+// Количество потоков для фильтров, которые умеют делить изображение на полосы
+void set_filter_threads(int threads);
+int get_filter_threads(void);
+
+// Обработка строк [0, h) полосами в set_filter_threads потоках
+typedef void (*BandWorker)(int y_begin, int y_end, void *ctx);
+void run_bands(int h, BandWorker worker, void *ctx);
+
+// Выделение границ за один проход: яркость -> свертка -> порог
+struct BMPImage* edge_detect(struct BMPImage *img, void *params);
+
+// Морфология (van Herk/Gil-Werman): стоимость на пиксель не зависит от размера элемента
+struct BMPImage* erode_image(struct BMPImage *img, void *params);
+struct BMPImage* dilate_image(struct BMPImage *img, void *params);
+struct BMPImage* open_image(struct BMPImage *img, void *params);
+struct BMPImage* close_image(struct BMPImage *img, void *params);
+
+struct BMPImage* print_hash_filter(struct BMPImage *img, void *params);  // -hash
+
+// Уменьшение в 2 раза усреднением и пирамида уровней
+struct BMPImage* downscale_2x(struct BMPImage *src);
+struct BMPImage** build_pyramid(struct BMPImage *src, int max_levels, int min_dim, int *count);
+void free_pyramid(struct BMPImage **levels, int count);
+
+// Размытия на скользящих суммах: стоимость на пиксель не зависит от радиуса
+struct BlurParams *create_box_blur_params(int radius);
+struct BlurParams *create_gauss_box_params(float sigma, int passes);  // приближение Гаусса
+struct BMPImage* box_blur(struct BMPImage *img, void *params);
+struct BMPImage* stack_blur(struct BMPImage *img, void *params);
+
 #endif // LABIP_FILTER_H
\ No newline at end of file
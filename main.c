@@ -5,12 +5,21 @@
 #include <time.h>
 #include "bmpreader.h"
 #include "filter.h"
+#include "pipeline.h"
+#include "memtrack.h"
+#include "stats.h"
+#include "perfcount.h"
 //1
 /*
- gcc -o image_processor main.c filter.c bmpreader.c -lm -Wall -Wextra -std=c11
+ gcc -o image_processor main.c filter.c bmpreader.c pipeline.c memtrack.c stats.c rng.c perfcount.c -lm -lpthread -Wall -Wextra -std=c11
 */
+// Возвращает результат (может быть тем же img) или NULL при ошибке; img при этом остается у вызывающего
 typedef struct BMPImage* (*SpecialTransform)(struct BMPImage *img, void *params);
 
+// -blur <sigma>: радиус ядра Гаусса; -blur <sigma> box: число box blur в приближении
+#define BLUR_KERNEL_RADIUS 2
+#define BLUR_BOX_PASSES 3
+
 
 struct FilterNode {
     enum { PIXEL_TRANSFORM, SPECIAL_TRANSFORM } type;
@@ -19,21 +28,17 @@ struct FilterNode {
         SpecialTransform special_transform;
     } transform;
     ParamsDestructor destructor;
+    ParamsScaler scaler;        // NULL, если параметры не зависят от масштаба
+    struct AccessPattern access;    // для PIXEL_TRANSFORM: какие пиксели читает преобразование
+    const char *name;           // опция, создавшая фильтр (для отчетов)
     void *params;
     struct FilterNode *next;
 };
 
-void add_pixel_filter(struct FilterNode **head,
-                     PixelTransform transform,
-                     ParamsDestructor destructor,
-                     void *params) {
-    struct FilterNode *node = malloc(sizeof(struct FilterNode));
-    node->type = PIXEL_TRANSFORM;
-    node->transform.pixel_transform = transform;
-    node->destructor = destructor;
-    node->params = params;
-    node->next = NULL;
+// -preview: длинная сторона результата, 0 - полное разрешение
+static int preview_max_dim = 0;
 
+void append_filter(struct FilterNode **head, struct FilterNode *node) {
     if (*head == NULL) {
         *head = node;
     } else {
@@ -43,43 +48,158 @@ void add_pixel_filter(struct FilterNode **head,
     }
 }
 
-void add_special_filter(struct FilterNode **head,
+int add_pixel_filter(struct FilterNode **head,
+                     PixelTransform transform,
+                     ParamsDestructor destructor,
+                     ParamsScaler scaler,
+                     struct AccessPattern access,
+                     void *params) {
+    // Фильтр без деструктора не имеет параметров; иначе NULL - ошибка выделения
+    int params_ok = params || !destructor;
+    struct FilterNode *node = params_ok ? mem_alloc(sizeof(struct FilterNode)) : NULL;
+    if (!node) {
+        fprintf(stderr, "Error: cannot allocate filter\n");
+        if (destructor && params) destructor(params);
+        return -1;
+    }
+    node->type = PIXEL_TRANSFORM;
+    node->transform.pixel_transform = transform;
+    node->destructor = destructor;
+    node->scaler = scaler;
+    node->access = access;
+    node->name = NULL;
+    node->params = params;
+    node->next = NULL;
+    append_filter(head, node);
+    return 0;
+}
+
+int add_special_filter(struct FilterNode **head,
                        SpecialTransform transform,
                        ParamsDestructor destructor,
+                       ParamsScaler scaler,
                        void *params) {
-    struct FilterNode *node = malloc(sizeof(struct FilterNode));
+    // Фильтр без деструктора не имеет параметров; иначе NULL - ошибка выделения
+    int params_ok = params || !destructor;
+    struct FilterNode *node = params_ok ? mem_alloc(sizeof(struct FilterNode)) : NULL;
+    if (!node) {
+        fprintf(stderr, "Error: cannot allocate filter\n");
+        if (destructor && params) destructor(params);
+        return -1;
+    }
     node->type = SPECIAL_TRANSFORM;
     node->transform.special_transform = transform;
     node->destructor = destructor;
+    node->scaler = scaler;
+    node->access = GEOMETRIC_ACCESS;
+    node->name = NULL;
     node->params = params;
     node->next = NULL;
+    append_filter(head, node);
+    return 0;
+}
 
-    if (*head == NULL) {
-        *head = node;
-    } else {
-        struct FilterNode *temp = *head;
-        while (temp->next) temp = temp->next;
-        temp->next = node;
+// Размер, который получится после фильтров rest: его меняют только crop
+void chain_output_size(struct FilterNode *rest, int *w, int *h) {
+    for (struct FilterNode *node = rest; node; node = node->next) {
+        if (node->type != SPECIAL_TRANSFORM || node->transform.special_transform != crop_image) continue;
+        struct CropParams *p = (struct CropParams *)node->params;
+        if (p->new_width < *w) *w = p->new_width;
+        if (p->new_height < *h) *h = p->new_height;
+    }
+}
+
+// Режим -preview: уменьшает изображение ровно во столько раз (степень двойки),
+// чтобы результат всей цепочки уложился в preview_max_dim по длинной стороне,
+// и пересчитывает параметры оставшихся фильтров под новый масштаб
+int apply_preview_downscale(struct BMPImage **img, struct FilterNode *rest) {
+    int w = (*img)->infoHeader.biWidth;
+    int h = abs((*img)->infoHeader.biHeight);
+    int out_w = w, out_h = h;
+    chain_output_size(rest, &out_w, &out_h);
+
+    int halvings = 0;
+    while ((out_w > out_h ? out_w : out_h) > preview_max_dim && (w > 1 || h > 1)) {
+        out_w = (out_w + 1) / 2;
+        out_h = (out_h + 1) / 2;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        halvings++;
+    }
+    if (halvings == 0) return 0;
+
+    int count = 0;
+    struct BMPImage **levels = build_pyramid(*img, halvings + 1, 0, &count);
+    if (!levels) {
+        fprintf(stderr, "Error: cannot allocate memory for preview\n");
+        return -1;
+    }
+
+    struct BMPImage *small = levels[count - 1];
+    levels[count - 1] = NULL;
+    free_pyramid(levels, count);
+
+    float factor = (float)small->infoHeader.biWidth / (float)(*img)->infoHeader.biWidth;
+    printf("  Preview: %d x %d -> %d x %d\n",
+           (*img)->infoHeader.biWidth, abs((*img)->infoHeader.biHeight),
+           small->infoHeader.biWidth, abs(small->infoHeader.biHeight));
+    free_bmp(*img);
+    *img = small;
+
+    for (struct FilterNode *node = rest; node; node = node->next) {
+        if (node->scaler) node->scaler(node->params, factor);
     }
+    return 0;
 }
 
-void apply_filter_chain(struct BMPImage **img, struct FilterNode *head) {
+int apply_filter_chain(struct BMPImage **img, struct FilterNode *head) {
     struct FilterNode *current = head;
+    int preview_pending = preview_max_dim > 0;
+    mem_set_stage(MEM_STAGE_FILTER);
     while (current) {
+        // Начальные crop только уменьшают изображение - их выполняем до уменьшения
+        int is_crop = current->type == SPECIAL_TRANSFORM &&
+                      current->transform.special_transform == crop_image;
+        if (preview_pending && !is_crop) {
+            preview_pending = 0;
+            if (apply_preview_downscale(img, current) != 0) {
+                mem_set_stage(MEM_STAGE_OTHER);
+                return -1;
+            }
+        }
+
+        struct PerfScope scope;
+        perf_scope_begin(&scope, current->name ? current->name : "filter");
         if (current->type == SPECIAL_TRANSFORM) {
-            // Специальные фильтры (crop)
+            // Специальные фильтры (crop, blur, морфология, границы)
             struct BMPImage *new_img = current->transform.special_transform(*img, current->params);
+            if (!new_img) {
+                perf_scope_end(&scope);
+                mem_set_stage(MEM_STAGE_OTHER);
+                return -1;
+            }
             if (*img != new_img) {
-                free((*img)->data);
-                free(*img);
+                mem_free((*img)->data);
+                mem_free(*img);
                 *img = new_img;
             }
         } else {
             // Обычные пиксельные трансформеры
-            apply_transform(*img, current->transform.pixel_transform, current->params);
+            if (apply_transform(*img, current->transform.pixel_transform, current->params,
+                                current->access) != 0) {
+                perf_scope_end(&scope);
+                mem_set_stage(MEM_STAGE_OTHER);
+                return -1;
+            }
         }
+        perf_scope_end(&scope);
         current = current->next;
     }
+
+    int status = 0;
+    if (preview_pending) status = apply_preview_downscale(img, NULL);
+    mem_set_stage(MEM_STAGE_OTHER);
+    return status;
 }
 
 void destroy_filter_chain(struct FilterNode *head) {
@@ -91,143 +211,471 @@ void destroy_filter_chain(struct FilterNode *head) {
             current->destructor(current->params);
         }
 
-        free(current);
+        mem_free(current);
         current = next;
     }
 }
 
-struct FilterNode *parse_arguments(int argc, char **argv, int img_width, int img_height) {
+// Цепочка фильтров из аргументов; -1, если какой-то фильтр не удалось создать
+int parse_arguments(int argc, char **argv, int img_width, int img_height, struct Rng *rng,
+                    struct FilterNode **filters) {
     struct FilterNode *head = NULL;
+    int status = 0;
 
     for (int i = 3; i < argc; i++) {
+        const char *option = argv[i];
 
         if (strcmp(argv[i], "-gs") == 0) {
-            struct formulaFilter *f = malloc(sizeof(struct formulaFilter));
-            f->coef[0] = 0.299f;
-            f->coef[1] = 0.587f;
-            f->coef[2] = 0.114f;
-            add_pixel_filter(&head, formula_transform, destroy_formula_filter, f);
+            struct formulaFilter *f = mem_alloc(sizeof(struct formulaFilter));
+            if (f) {
+                f->coef[0] = 0.299f;
+                f->coef[1] = 0.587f;
+                f->coef[2] = 0.114f;
+            }
+            status |= add_pixel_filter(&head, formula_transform, destroy_formula_filter, NULL, POINT_ACCESS, f);
         }
 
         else if (strcmp(argv[i], "-blur") == 0 && i + 1 < argc) {
             float sigma = atof(argv[++i]);
             if (sigma <= 0) sigma = 1.0f;
-            struct matrixFilter *kernel = create_gauss_kernel(2, sigma);
-            add_pixel_filter(&head, matrix_transform, destroy_matrix_filter, kernel);
+            // Ядро 5x5 обрезает Гаусса с большой sigma; "box" - приближение несколькими box blur
+            if (i + 1 < argc && strcmp(argv[i + 1], "box") == 0) {
+                i++;
+                struct BlurParams *p = create_gauss_box_params(sigma, BLUR_BOX_PASSES);
+                status |= add_special_filter(&head, box_blur, destroy_blur_params, scale_blur_params, p);
+            } else {
+                struct matrixFilter *kernel = create_gauss_kernel(BLUR_KERNEL_RADIUS, sigma);
+                status |= add_pixel_filter(&head, select_matrix_transform(kernel), destroy_matrix_filter,
+                                           scale_matrix_filter, NEIGHBORHOOD_ACCESS(BLUR_KERNEL_RADIUS), kernel);
+            }
+        }
+
+        else if (strcmp(argv[i], "-boxblur") == 0 && i + 1 < argc) {
+            int radius = atoi(argv[++i]);
+            if (radius <= 0) radius = 1;
+            status |= add_special_filter(&head, box_blur, destroy_blur_params, scale_blur_params,
+                                         create_box_blur_params(radius));
+        }
+
+        else if (strcmp(argv[i], "-stackblur") == 0 && i + 1 < argc) {
+            int radius = atoi(argv[++i]);
+            if (radius <= 0) radius = 1;
+            status |= add_special_filter(&head, stack_blur, destroy_blur_params, scale_blur_params,
+                                         create_box_blur_params(radius));
         }
 
         else if (strcmp(argv[i], "-med") == 0 && i + 1 < argc) {
-            struct MedianParams *p = malloc(sizeof(struct MedianParams));
-            p->window_size = atoi(argv[++i]);
-            if (p->window_size % 2 == 0) p->window_size++;
-            if (p->window_size < 3) p->window_size = 3;
-            add_pixel_filter(&head, transformer_median, destroy_median_params, p);
+            int size = atoi(argv[++i]);
+            if (size % 2 == 0) size++;
+            if (size < 3) size = 3;
+            // -preview может только уменьшить окно, поэтому радиус остается верхней границей
+            status |= add_pixel_filter(&head, transformer_median, destroy_median_params, scale_median_params,
+                                       NEIGHBORHOOD_ACCESS(size / 2), create_median_params(size));
         }
 
         else if (strcmp(argv[i], "-vortex") == 0 && i + 2 < argc) {
-            struct vortex *p = malloc(sizeof(struct vortex));
-            p->angle = atof(argv[++i]);
-            p->radius = atof(argv[++i]);
-            if (p->radius <= 0) p->radius = 100.0f;
-            add_pixel_filter(&head, transformer_vortex, destroy_vortex_params, p);
+            float angle = atof(argv[++i]);
+            float radius = atof(argv[++i]);
+            struct vortex *p = mem_alloc(sizeof(struct vortex));
+            if (p) {
+                p->angle = angle;
+                p->radius = (radius <= 0) ? 100.0f : radius;
+            }
+            status |= add_pixel_filter(&head, transformer_vortex, destroy_vortex_params, scale_vortex_params,
+                                       GEOMETRIC_ACCESS, p);
         }
 
         else if (strcmp(argv[i], "-neg") == 0) {
-            struct formulaFilter *f = malloc(sizeof(struct formulaFilter));
-            f->coef[0] = 255;
-            f->coef[1] = 255;
-            f->coef[2] = 255;
-            add_pixel_filter(&head, shift_transform, destroy_formula_filter, f);
+            struct formulaFilter *f = mem_alloc(sizeof(struct formulaFilter));
+            if (f) {
+                f->coef[0] = 255;
+                f->coef[1] = 255;
+                f->coef[2] = 255;
+            }
+            status |= add_pixel_filter(&head, shift_transform, destroy_formula_filter, NULL, POINT_ACCESS, f);
         }
 
         else if (strcmp(argv[i], "-crystallize") == 0 && i + 1 < argc) {
             int count = atoi(argv[++i]);
             if (count > 0) {
-                struct CrystalParams *p = malloc(sizeof(struct CrystalParams));
-                p->points_count = count;
-                p->coords_x = malloc(count * sizeof(int));
-                p->coords_y = malloc(count * sizeof(int));
-
-                if (i + 2 * count < argc) {
-                    for (int j = 0; j < count; j++) {
-                        p->coords_x[j] = atoi(argv[++i]);
-                        p->coords_y[j] = atoi(argv[++i]);
+                struct CrystalParams *p = mem_alloc(sizeof(struct CrystalParams));
+                if (p) {
+                    p->points_count = count;
+                    p->coords_x = mem_alloc((size_t)count * sizeof(int));
+                    p->coords_y = mem_alloc((size_t)count * sizeof(int));
+                    if (!p->coords_x || !p->coords_y) {
+                        destroy_crystal_params(p);
+                        p = NULL;
                     }
-                } else {
+                }
+
+                int explicit_points = i + 2 * count < argc;
+                if (p && explicit_points) {
                     for (int j = 0; j < count; j++) {
-                        p->coords_x[j] = rand() % img_width;
-                        p->coords_y[j] = rand() % img_height;
+                        p->coords_x[j] = atoi(argv[i + 1 + 2 * j]);
+                        p->coords_y[j] = atoi(argv[i + 2 + 2 * j]);
                     }
+                } else if (p) {
+                    poisson_disk_points(img_width, img_height, count, rng, p->coords_x, p->coords_y);
                 }
-                add_pixel_filter(&head, transformer_crystallize, destroy_crystal_params, p);
+                if (explicit_points) i += 2 * count;
+                status |= add_pixel_filter(&head, transformer_crystallize, destroy_crystal_params, scale_crystal_params,
+                                           GEOMETRIC_ACCESS, p);
             }
         }
 
         else if (strcmp(argv[i], "-sharp") == 0) {
-            struct matrixFilter *p = malloc(sizeof(struct matrixFilter));
-            p->size = 3;
-            p->matrix = malloc(9 * sizeof(float));
-            float sharp_kernel[9] = {0.0f, -1.0f, 0.0f,
-                                     -1.0f, 5.0f, -1.0f,
-                                      0.0f, -1.0f, 0.0f};
-            memcpy(p->matrix, sharp_kernel, 9 * sizeof(float));
-            add_pixel_filter(&head, matrix_transform, destroy_matrix_filter, p);
+            struct matrixFilter *p = create_sharp_kernel();
+            status |= add_pixel_filter(&head, select_matrix_transform(p), destroy_matrix_filter,
+                                       scale_matrix_filter, NEIGHBORHOOD_ACCESS(1), p);
         }
 
         else if (strcmp(argv[i], "-edge") == 0 && i + 1 < argc) {
+            int auto_threshold = strcmp(argv[i + 1], "auto") == 0;
             double t = atof(argv[++i]);
+            enum EdgeOperator op = EDGE_LAPLACE;
+            if (i + 1 < argc && strcmp(argv[i + 1], "sobel") == 0) {
+                op = EDGE_SOBEL;
+                i++;
+            } else if (i + 1 < argc && strcmp(argv[i + 1], "laplace") == 0) {
+                i++;
+            }
+
+            struct EdgeDetectParams *e = mem_alloc(sizeof(struct EdgeDetectParams));
+            if (e) {
+                // Отклик лежит в 0..255: порог вне [-1, 255] ничего не меняет, а t*255 не переполняет int
+                double threshold = t*255;
+                if (threshold < -1) threshold = -1;
+                if (threshold > 255) threshold = 255;
+                e->threshold = (int)threshold;
+                e->op = op;
+                e->auto_threshold = auto_threshold;
+            }
+
+            if (get_reference_mode() && op == EDGE_LAPLACE && !auto_threshold) {
+                // Эталон: исходная цепочка grayscale -> Лапласиан -> порог
+                struct formulaFilter *f = mem_alloc(sizeof(struct formulaFilter));
+                if (f) {
+                    f->coef[0] = 0.299f;
+                    f->coef[1] = 0.587f;
+                    f->coef[2] = 0.114f;
+                }
+                status |= add_pixel_filter(&head, formula_transform, destroy_formula_filter, NULL,
+                                           POINT_ACCESS, f);
+                status |= add_pixel_filter(&head, matrix_transform, destroy_matrix_filter, NULL,
+                                           NEIGHBORHOOD_ACCESS(1), create_laplace_kernel());
+                status |= add_pixel_filter(&head, threshold_transform, destroy_edge_params, NULL,
+                                           POINT_ACCESS, e);
+            } else {
+                status |= add_special_filter(&head, edge_detect, destroy_edge_params, NULL, e);
+            }
+        }
+
+        else if (strcmp(argv[i], "-hash") == 0) {
+            status |= add_special_filter(&head, print_hash_filter, NULL, NULL, NULL);
+        }
+
+        else if (strcmp(argv[i], "-stats") == 0) {
+            int print_histogram = i + 1 < argc && strcmp(argv[i + 1], "hist") == 0;
+            if (print_histogram) i++;
+            struct StatsParams *p = mem_alloc(sizeof(struct StatsParams));
+            if (p) p->print_histogram = print_histogram;
+            status |= add_special_filter(&head, stats_filter, destroy_stats_params, NULL, p);
+        }
+
+        else if (strcmp(argv[i], "-equalize") == 0) {
+            status |= add_special_filter(&head, equalize_image, NULL, NULL, NULL);
+        }
+
+        else if (strcmp(argv[i], "-autolevels") == 0) {
+            status |= add_special_filter(&head, autolevels_image, NULL, NULL, NULL);
+        }
+
+        else if ((strcmp(argv[i], "-erode") == 0 || strcmp(argv[i], "-dilate") == 0 ||
+                  strcmp(argv[i], "-open") == 0 || strcmp(argv[i], "-close") == 0) && i + 2 < argc) {
+            const char *name = argv[i];
+            int width = atoi(argv[++i]);
+            int height = atoi(argv[++i]);
+            struct MorphParams *p = mem_alloc(sizeof(struct MorphParams));
+            if (p) {
+                p->width = (width <= 0) ? 3 : width;
+                p->height = (height <= 0) ? 3 : height;
+            }
+
+            SpecialTransform op = erode_image;
+            if (strcmp(name, "-dilate") == 0) op = dilate_image;
+            else if (strcmp(name, "-open") == 0) op = open_image;
+            else if (strcmp(name, "-close") == 0) op = close_image;
+            status |= add_special_filter(&head, op, destroy_morph_params, scale_morph_params, p);
+        }
+
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            set_filter_threads(atoi(argv[++i]));
+        }
 
+        else if (strcmp(argv[i], "-preview") == 0 && i + 1 < argc) {
+            preview_max_dim = atoi(argv[++i]);
+            if (preview_max_dim < 0) preview_max_dim = 0;
+        }
 
-            struct formulaFilter *f = malloc(sizeof(struct formulaFilter));
-            f->coef[0] = 0.299f;
-            f->coef[1] = 0.587f;
-            f->coef[2] = 0.114f;
-            add_pixel_filter(&head, formula_transform, destroy_formula_filter, f);
+        else if (strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc) {
+            i++;  // уже учтен в parse_mem_limit
+        }
 
-            struct matrixFilter *p = malloc(sizeof(struct matrixFilter));
-            p->size = 3;
-            p->matrix = malloc(9 * sizeof(float));
-            float edge_kernel[9] = { 0.0f, -1.0f,  0.0f,
-                                     -1.0f, 4.0f, -1.0f,
-                                     0.0f,  -1.0f, 0.0f};
-            memcpy(p->matrix, edge_kernel, 9 * sizeof(float));
-            add_pixel_filter(&head, matrix_transform, destroy_matrix_filter, p);
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            i++;  // уже учтен в parse_seed
+        }
+
+        else if (strcmp(argv[i], "-perf") == 0 && i + 1 < argc) {
+            i++;  // уже учтен в main
+        }
 
-            struct EdgeDetectParams *e = malloc(sizeof(struct EdgeDetectParams));
-            e->threshold = t*255;
-            add_pixel_filter(&head, threshold_transform, destroy_edge_params, e);
+        else if (strcmp(argv[i], "--expect-hash") == 0 && i + 1 < argc) {
+            i++;  // проверяется после применения фильтров
+        }
+
+        else if (strcmp(argv[i], "-reference") == 0) {
+            // уже учтен в main
         }
 
         else if (strcmp(argv[i], "-crop") == 0 && i + 2 < argc) {
-            struct CropParams *p = malloc(sizeof(struct CropParams));
-            p->new_width = atoi(argv[++i]);
-            p->new_height = atoi(argv[++i]);
-            if (p->new_width <= 0) p->new_width = 100;
-            if (p->new_height <= 0) p->new_height = 100;
-            add_special_filter(&head, crop_image, destroy_crop_params, p);
+            int width = atoi(argv[++i]);
+            int height = atoi(argv[++i]);
+            struct CropParams *p = mem_alloc(sizeof(struct CropParams));
+            if (p) {
+                p->new_width = (width <= 0) ? 100 : width;
+                p->new_height = (height <= 0) ? 100 : height;
+            }
+            status |= add_special_filter(&head, crop_image, destroy_crop_params, scale_crop_params, p);
         }
 
         else {
             fprintf(stderr, "unknown argument- '%s'\n", argv[i]);
         }
+
+        if (status != 0) {
+            destroy_filter_chain(head);
+            *filters = NULL;
+            return -1;
+        }
+
+        // Фильтры, добавленные этой опцией, получают ее имя
+        for (struct FilterNode *node = head; node; node = node->next) {
+            if (!node->name) node->name = option;
+        }
+    }
+
+    *filters = head;
+    return 0;
+}
+
+// Индекс значения опции name или -1, если опции нет
+int find_option(int argc, char **argv, const char *name) {
+    for (int i = 3; i < argc - 1; i++) {
+        if (strcmp(argv[i], name) == 0) return i + 1;
+    }
+    return -1;
+}
+
+// Лимит памяти нужен до загрузки изображения, поэтому разбирается отдельно
+void parse_mem_limit(int argc, char **argv) {
+    int i = find_option(argc, argv, "--mem-limit");
+    if (i < 0) return;
+    size_t limit = mem_parse_size(argv[i]);
+    if (limit == 0) {
+        fprintf(stderr, "Warning: invalid memory limit '%s' ignored\n", argv[i]);
+    }
+    mem_set_limit(limit);
+}
+
+// Seed для случайных параметров: -seed <n> или текущее время
+uint64_t parse_seed(int argc, char **argv) {
+    int i = find_option(argc, argv, "-seed");
+    if (i < 0) return (uint64_t)time(NULL);
+    return strtoull(argv[i], NULL, 10);
+}
+
+// Сверка результата с эталонным хешем (--expect-hash <hex>); 0 - совпал или не задан
+int check_expected_hash(int argc, char **argv, struct BMPImage *img) {
+    int i = find_option(argc, argv, "--expect-hash");
+    if (i < 0) return 0;
+    uint64_t expected = strtoull(argv[i], NULL, 16);
+    uint64_t actual = image_hash(img);
+    if (actual != expected) {
+        fprintf(stderr, "Error: hash mismatch: expected %016llx, got %016llx\n",
+                (unsigned long long)expected, (unsigned long long)actual);
+        return -1;
+    }
+    printf("  Hash matches: %016llx\n", (unsigned long long)actual);
+    return 0;
+}
+
+// Размер очередей между стадиями конвейера (изображений "в полете")
+#define BATCH_QUEUE_CAPACITY 2
+
+struct BatchContext {
+    int argc;
+    char **argv;
+    struct PipelineJob *jobs;
+    uint64_t seed;
+};
+
+// Стадия вычислений пакетного режима: своя цепочка фильтров для каждого файла
+int process_batch_job(struct PipelineJob *job, void *ctx) {
+    struct BatchContext *bc = (struct BatchContext *)ctx;
+    int img_width = job->img->infoHeader.biWidth;
+    int img_height = abs(job->img->infoHeader.biHeight);
+
+    // Поток генератора - номер задачи: результат не зависит от порядка и числа потоков
+    struct Rng rng;
+    rng_seed(&rng, bc->seed, (uint64_t)(job - bc->jobs));
+
+    struct FilterNode *filters;
+    int status = parse_arguments(bc->argc, bc->argv, img_width, img_height, &rng, &filters);
+    // -preview не добавляет узла: уменьшение выполняет apply_filter_chain и для пустой цепочки
+    if (status == 0 && (filters || preview_max_dim > 0)) {
+        status = apply_filter_chain(&job->img, filters);
+        destroy_filter_chain(filters);
+    }
+    if (status != 0) return -1;
+    if (check_expected_hash(bc->argc, bc->argv, job->img) != 0) return -1;
+    printf("  Processed: %s -> %s (%d x %d)\n", job->input, job->output,
+           job->img->infoHeader.biWidth, abs(job->img->infoHeader.biHeight));
+    return 0;
+}
+
+char *copy_string(const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = mem_alloc(len);
+    if (copy) memcpy(copy, s, len);
+    return copy;
+}
+
+void free_batch_list(struct PipelineJob *jobs, int count) {
+    for (int i = 0; i < count; i++) {
+        mem_free((char *)jobs[i].input);
+        mem_free((char *)jobs[i].output);
+    }
+    mem_free(jobs);
+}
+
+// Чтение списка задач: по одной паре "input.bmp output.bmp" на строку
+struct PipelineJob *read_batch_list(const char *filename, int *count) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Error: cannot open batch list '%s'\n", filename);
+        return NULL;
+    }
+
+    int capacity = 16;
+    struct PipelineJob *jobs = mem_alloc(capacity * sizeof(struct PipelineJob));
+    if (!jobs) {
+        fclose(f);
+        return NULL;
+    }
+
+    *count = 0;
+    char in[1024], out[1024];
+    while (fscanf(f, "%1023s %1023s", in, out) == 2) {
+        if (*count == capacity) {
+            capacity *= 2;
+            struct PipelineJob *grown = mem_realloc(jobs, capacity * sizeof(struct PipelineJob));
+            if (!grown) {
+                // Неполный список обработал бы не все файлы и сообщил бы об успехе
+                fprintf(stderr, "Error: cannot allocate memory for batch list '%s'\n", filename);
+                free_batch_list(jobs, *count);
+                fclose(f);
+                return NULL;
+            }
+            jobs = grown;
+        }
+        struct PipelineJob *job = &jobs[(*count)++];
+        job->input = copy_string(in);
+        job->output = copy_string(out);
+        job->img = NULL;
+        job->status = 0;
+        if (!job->input || !job->output) {
+            fprintf(stderr, "Error: cannot allocate memory for batch list '%s'\n", filename);
+            free_batch_list(jobs, *count);
+            fclose(f);
+            return NULL;
+        }
     }
 
-    return head;
+    fclose(f);
+    return jobs;
+}
+
+int run_batch(int argc, char **argv) {
+    int count = 0;
+    struct PipelineJob *jobs = read_batch_list(argv[2], &count);
+    if (!jobs) {
+        perf_write_json();
+        return 1;
+    }
+
+    uint64_t seed = parse_seed(argc, argv);
+    printf("Processing batch: %d image(s) from %s\n", count, argv[2]);
+    printf("  Seed: %llu\n", (unsigned long long)seed);
+
+    struct BatchContext ctx = {argc, argv, jobs, seed};
+    int failed = run_pipeline(jobs, count, BATCH_QUEUE_CAPACITY, process_batch_job, &ctx);
+    free_batch_list(jobs, count);
+    mem_print_report(stdout);
+    perf_write_json();
+
+    if (failed != 0) {
+        fprintf(stderr, "Error: batch finished with %d failed image(s)\n", failed < 0 ? count : failed);
+        return 1;
+    }
+    printf("  Done! %d image(s) successfully saved.\n", count);
+    return 0;
 }
 
 int main(int argc, char **argv) {
+    parse_mem_limit(argc, argv);
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-reference") == 0) set_reference_mode(1);
+    }
+    int perf_option = find_option(argc, argv, "-perf");
+    if (perf_option > 0) perf_enable(argv[perf_option]);
+
+    if (argc >= 3 && strcmp(argv[1], "-batch") == 0) {
+        return run_batch(argc, argv);
+    }
+
     if (argc < 3) {
         printf("Usage: %s input.bmp output.bmp [filters]\n", argv[0]);
+        printf("       %s -batch list.txt [filters]\n", argv[0]);
+        printf("       (list.txt: one \"input.bmp output.bmp\" pair per line)\n");
+        printf("       input \"synth:WxH\" generates a deterministic test image\n");
         printf("\nFilters:\n");
         printf("  -gs                    - grayscale\n");
-        printf("  -blur <sigma>          - Gaussian blur\n");
+        printf("  -blur <sigma> [box]    - Gaussian blur (box: multi-pass box approximation)\n");
+        printf("  -boxblur <radius>      - box blur\n");
+        printf("  -stackblur <radius>    - stack blur\n");
         printf("  -med <size>            - median filter\n");
         printf("  -vortex <angle> <radius> - vortex effect\n");
         printf("  -neg                   - negative\n");
         printf("  -crystallize <count> [x1 y1 ...] - crystallize\n");
         printf("  -sharp                 - sharpen\n");
-        printf("  -edge <threshold>      - edge detection (0-255)\n");
+        printf("  -edge <threshold|auto> [laplace|sobel] - edge detection (0-1 or Otsu)\n");
         printf("  -crop <width> <height> - crop image\n");
+        printf("  -erode <w> <h>         - erosion with a w x h rectangle\n");
+        printf("  -dilate <w> <h>        - dilation with a w x h rectangle\n");
+        printf("  -open <w> <h>          - opening (erode, then dilate)\n");
+        printf("  -close <w> <h>         - closing (dilate, then erode)\n");
+        printf("  -stats [hist]          - print channel statistics at this point\n");
+        printf("  -equalize              - histogram equalization\n");
+        printf("  -autolevels            - stretch each channel to 0-255\n");
+        printf("  -threads <n>           - worker threads for banded filters\n");
+        printf("  -seed <n>              - seed for random parameters (crystallize)\n");
+        printf("  -hash                  - print a hash of the image at this point\n");
+        printf("  --expect-hash <hex>    - fail (exit 2) unless the result has this hash\n");
+        printf("  -reference             - use reference implementations only\n");
+        printf("  -perf <report.json>    - per-stage time and hardware counters\n");
+        printf("  -preview <max_dim>     - fast preview no larger than max_dim\n");
+        printf("  --mem-limit <size>     - memory budget, e.g. 512M or 2G\n");
         return 1;
     }
 
@@ -238,24 +686,47 @@ int main(int argc, char **argv) {
     printf("  Input:  %s\n", input_file);
     printf("  Output: %s\n", output_file);
 
+    struct PerfScope scope;
+    mem_set_stage(MEM_STAGE_LOAD);
+    perf_scope_begin(&scope, "load");
     struct BMPImage *img = load_bmp(input_file);
+    perf_scope_end(&scope);
+    mem_set_stage(MEM_STAGE_OTHER);
     if (!img) {
         fprintf(stderr, "Error: could not load file '%s'\n", input_file);
+        perf_write_json();
         return 1;
     }
 
-    srand((unsigned int)time(NULL));
+    uint64_t seed = parse_seed(argc, argv);
+    struct Rng rng;
+    rng_seed(&rng, seed, 0);
 
     int img_width = img->infoHeader.biWidth;
     int img_height = abs(img->infoHeader.biHeight);
 
     printf("  Size: %d x %d pixels\n", img_width, img_height);
+    printf("  Seed: %llu\n", (unsigned long long)seed);
 
-    struct FilterNode *filters = parse_arguments(argc, argv, img_width, img_height);
+    struct FilterNode *filters;
+    if (parse_arguments(argc, argv, img_width, img_height, &rng, &filters) != 0) {
+        fprintf(stderr, "Error: could not create filters\n");
+        free_bmp(img);
+        mem_print_report(stderr);
+        perf_write_json();
+        return 1;
+    }
 
-    if (filters) {
+    if (filters || preview_max_dim > 0) {
         printf("  Applying filters...\n");
-        apply_filter_chain(&img, filters);
+        if (apply_filter_chain(&img, filters) != 0) {
+            fprintf(stderr, "Error: could not apply filters\n");
+            destroy_filter_chain(filters);
+            free_bmp(img);
+            mem_print_report(stderr);
+            perf_write_json();
+            return 1;
+        }
         printf("  New size: %d x %d pixels\n",
                img->infoHeader.biWidth,
                abs(img->infoHeader.biHeight));
@@ -263,17 +734,28 @@ int main(int argc, char **argv) {
         printf("  Warning: arguments specified but no filters recognized\n");
     }
 
-    if (save_bmp(output_file, img) != 0) {
+    mem_set_stage(MEM_STAGE_SAVE);
+    perf_scope_begin(&scope, "save");
+    int saved = save_bmp(output_file, img);
+    perf_scope_end(&scope);
+    mem_set_stage(MEM_STAGE_OTHER);
+    if (saved != 0) {
         fprintf(stderr, "Error: could not save file '%s'\n", output_file);
         if (filters) destroy_filter_chain(filters);
         free_bmp(img);
+        mem_print_report(stderr);
+        perf_write_json();
         return 1;
     }
 
     printf("  Done! Image successfully saved.\n");
 
+    int hash_status = check_expected_hash(argc, argv, img);
+    perf_write_json();
+
     if (filters) destroy_filter_chain(filters);
     free_bmp(img);
+    mem_print_report(stdout);
 
-    return 0;
+    return hash_status == 0 ? 0 : 2;
 }
\ No newline at end of file
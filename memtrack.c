@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "memtrack.h"
+
+// Заголовок перед каждым блоком: размер и стадия, в которой блок выделен
+union MemHeader {
+    struct {
+        size_t size;
+        int stage;
+    } info;
+    max_align_t align;
+};
+
+static const char *stage_names[MEM_STAGE_COUNT] = {"other", "load", "filter", "save"};
+
+static atomic_size_t current_bytes;
+static atomic_size_t peak_bytes;
+static atomic_size_t stage_current[MEM_STAGE_COUNT];
+static atomic_size_t stage_peak[MEM_STAGE_COUNT];
+static size_t limit_bytes = 0;
+
+static _Thread_local enum MemStage current_stage = MEM_STAGE_OTHER;
+
+static void update_peak(atomic_size_t *peak, size_t value) {
+    size_t old = atomic_load(peak);
+    while (value > old && !atomic_compare_exchange_weak(peak, &old, value)) {
+    }
+}
+
+// Резервирует size байт в общем счетчике; 0 - лимит превышен
+static int reserve(size_t size) {
+    size_t old = atomic_load(&current_bytes);
+    do {
+        if (limit_bytes != 0 && (old + size < old || old + size > limit_bytes)) {
+            return 0;
+        }
+    } while (!atomic_compare_exchange_weak(&current_bytes, &old, old + size));
+    update_peak(&peak_bytes, old + size);
+    return 1;
+}
+
+void *mem_alloc(size_t size) {
+    if (size > (size_t)-1 - sizeof(union MemHeader)) return NULL;
+    if (!reserve(size)) {
+        fprintf(stderr, "Error: memory limit exceeded (%zu bytes requested, %zu of %zu in use)\n",
+                size, atomic_load(&current_bytes), limit_bytes);
+        return NULL;
+    }
+
+    union MemHeader *header = malloc(sizeof(union MemHeader) + size);
+    if (!header) {
+        atomic_fetch_sub(&current_bytes, size);
+        return NULL;
+    }
+    header->info.size = size;
+    header->info.stage = current_stage;
+
+    size_t stage_now = atomic_fetch_add(&stage_current[current_stage], size) + size;
+    update_peak(&stage_peak[current_stage], stage_now);
+    return header + 1;
+}
+
+void *mem_calloc(size_t count, size_t size) {
+    if (size != 0 && count > (size_t)-1 / size) return NULL;
+    void *ptr = mem_alloc(count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *mem_realloc(void *ptr, size_t size) {
+    if (!ptr) return mem_alloc(size);
+    union MemHeader *header = (union MemHeader *)ptr - 1;
+    void *grown = mem_alloc(size);
+    if (!grown) return NULL;
+    memcpy(grown, ptr, header->info.size < size ? header->info.size : size);
+    mem_free(ptr);
+    return grown;
+}
+
+void mem_free(void *ptr) {
+    if (!ptr) return;
+    union MemHeader *header = (union MemHeader *)ptr - 1;
+    atomic_fetch_sub(&current_bytes, header->info.size);
+    atomic_fetch_sub(&stage_current[header->info.stage], header->info.size);
+    free(header);
+}
+
+void mem_set_stage(enum MemStage stage) {
+    current_stage = stage;
+}
+
+void mem_set_limit(size_t bytes) {
+    limit_bytes = bytes;
+}
+
+size_t mem_get_limit(void) {
+    return limit_bytes;
+}
+
+int mem_would_exceed(size_t bytes) {
+    return limit_bytes != 0 && atomic_load(&current_bytes) + bytes > limit_bytes;
+}
+
+size_t mem_parse_size(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    if (value <= 0) return 0;
+    switch (*end) {
+        case 'k': case 'K': value *= 1024.0; break;
+        case 'm': case 'M': value *= 1024.0 * 1024.0; break;
+        case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; break;
+        default: break;
+    }
+    return (size_t)value;
+}
+
+size_t mem_current(void) {
+    return atomic_load(&current_bytes);
+}
+
+size_t mem_peak(void) {
+    return atomic_load(&peak_bytes);
+}
+
+void mem_print_report(FILE *out) {
+    fprintf(out, "Memory: peak %zu bytes", mem_peak());
+    if (limit_bytes != 0) fprintf(out, " (limit %zu)", limit_bytes);
+    fprintf(out, "\n");
+    for (int s = 0; s < MEM_STAGE_COUNT; s++) {
+        fprintf(out, "  %-7s peak %zu bytes\n", stage_names[s], atomic_load(&stage_peak[s]));
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef LABIP_MEMTRACK_H
+#define LABIP_MEMTRACK_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Стадии, по которым ведется учет памяти
+enum MemStage {
+    MEM_STAGE_OTHER,
+    MEM_STAGE_LOAD,
+    MEM_STAGE_FILTER,
+    MEM_STAGE_SAVE,
+    MEM_STAGE_COUNT
+};
+
+// Выделение памяти с учетом текущего и пикового объема.
+// При заданном лимите выделение сверх него возвращает NULL
+void *mem_alloc(size_t size);
+void *mem_calloc(size_t count, size_t size);
+void *mem_realloc(void *ptr, size_t size);
+void mem_free(void *ptr);
+
+// Стадия задается для текущего потока
+void mem_set_stage(enum MemStage stage);
+
+// Лимит в байтах, 0 - без ограничений
+void mem_set_limit(size_t bytes);
+size_t mem_get_limit(void);
+int mem_would_exceed(size_t bytes);      // 1, если еще bytes байт не поместятся в лимит
+size_t mem_parse_size(const char *text); // "512M", "2G", "65536K", "1000000"
+
+size_t mem_current(void);
+size_t mem_peak(void);
+void mem_print_report(FILE *out);
+
+#endif // LABIP_MEMTRACK_H
@@ -0,0 +1,206 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // syscall()
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "memtrack.h"
+#include "perfcount.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char *counter_names[PERF_COUNTERS] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+struct PerfRecord {
+    const char *name;
+    double seconds;
+    uint64_t values[PERF_COUNTERS];     // уже пересчитаны на все время замера
+    int valid[PERF_COUNTERS];
+    double running;                     // доля времени, когда группа была на PMU
+};
+
+static const char *report_path = NULL;
+static struct PerfRecord *records = NULL;
+static int record_count = 0;
+static int record_capacity = 0;
+static pthread_mutex_t records_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void perf_enable(const char *json_path) {
+    report_path = json_path;
+}
+
+int perf_enabled(void) {
+    return report_path != NULL;
+}
+
+#ifdef __linux__
+static const uint64_t counter_configs[PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// Счетчики открываются одной группой: ядро включает их на PMU только вместе,
+// поэтому при мультиплексировании все значения относятся к одним и тем же
+// интервалам. Чтение группы: nr, time_enabled, time_running, values[nr]
+#define GROUP_READ_FORMAT (PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | \
+                           PERF_FORMAT_TOTAL_TIME_RUNNING)
+
+// Счетчик для текущего потока и потоков, созданных во время замера
+// (полосы фильтров), только пользовательский код. group_fd < 0 - лидер группы
+static int open_counter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group_fd < 0;    // остальные следуют за лидером
+    attr.read_format = GROUP_READ_FORMAT;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+void perf_scope_begin(struct PerfScope *scope, const char *name) {
+    scope->name = name;
+    scope->active = perf_enabled();
+    for (int c = 0; c < PERF_COUNTERS; c++) scope->fds[c] = -1;
+    if (!scope->active) return;
+
+#ifdef __linux__
+    // Лидер - первый счетчик, который удалось открыть; недоступные пропускаются
+    int leader = -1;
+    for (int c = 0; c < PERF_COUNTERS; c++) {
+        scope->fds[c] = open_counter(counter_configs[c], leader);
+        if (leader < 0) leader = scope->fds[c];
+    }
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    timespec_get(&scope->start, TIME_UTC);
+}
+
+void perf_scope_end(struct PerfScope *scope) {
+    if (!scope->active) return;
+
+    struct timespec end;
+    timespec_get(&end, TIME_UTC);
+
+    struct PerfRecord record;
+    memset(&record, 0, sizeof(record));
+    record.name = scope->name;
+    record.seconds = (double)(end.tv_sec - scope->start.tv_sec) +
+                     (double)(end.tv_nsec - scope->start.tv_nsec) / 1e9;
+
+#ifdef __linux__
+    int leader = -1;
+    for (int c = 0; c < PERF_COUNTERS && leader < 0; c++) leader = scope->fds[c];
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t data[3 + PERF_COUNTERS] = {0};
+        ssize_t got = read(leader, data, sizeof(data));
+        uint64_t nr = got >= (ssize_t)(3 * sizeof(uint64_t)) ? data[0] : 0;
+        uint64_t enabled = data[1];
+        uint64_t running = data[2];
+        // Группа была на PMU только часть времени (мультиплексирование):
+        // экстраполируем на все время замера. running == 0 - значений нет
+        if (nr > 0 && got == (ssize_t)((3 + nr) * sizeof(uint64_t)) && running > 0) {
+            double scale = (double)enabled / (double)running;
+            uint64_t i = 0;
+            for (int c = 0; c < PERF_COUNTERS && i < nr; c++) {
+                if (scope->fds[c] < 0) continue;
+                record.values[c] = (uint64_t)((double)data[3 + i++] * scale + 0.5);
+                record.valid[c] = 1;
+            }
+            record.running = (double)running / (double)enabled;
+        }
+    }
+    for (int c = 0; c < PERF_COUNTERS; c++) {
+        if (scope->fds[c] >= 0) close(scope->fds[c]);
+        scope->fds[c] = -1;
+    }
+#endif
+    scope->active = 0;
+
+    pthread_mutex_lock(&records_lock);
+    if (record_count == record_capacity) {
+        int capacity = record_capacity ? record_capacity * 2 : 16;
+        struct PerfRecord *grown = mem_realloc(records, capacity * sizeof(struct PerfRecord));
+        if (grown) {
+            records = grown;
+            record_capacity = capacity;
+        }
+    }
+    if (record_count < record_capacity) records[record_count++] = record;
+    pthread_mutex_unlock(&records_lock);
+}
+
+// Имена стадий берутся из аргументов командной строки - экранируем для JSON
+static void write_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", (unsigned char)*s);
+        else fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+int perf_write_json(void) {
+    if (!perf_enabled()) return 0;
+
+    FILE *f = fopen(report_path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: cannot create perf report '%s'\n", report_path);
+        return -1;
+    }
+
+    int available = 0;
+    for (int i = 0; i < record_count; i++) {
+        for (int c = 0; c < PERF_COUNTERS; c++) available |= records[i].valid[c];
+    }
+
+    fprintf(f, "{\n  \"counters_available\": %s,\n  \"stages\": [\n", available ? "true" : "false");
+    for (int i = 0; i < record_count; i++) {
+        struct PerfRecord *r = &records[i];
+        fprintf(f, "    {\"name\": ");
+        write_json_string(f, r->name);
+        fprintf(f, ", \"seconds\": %.6f", r->seconds);
+        for (int c = 0; c < PERF_COUNTERS; c++) {
+            if (r->valid[c]) fprintf(f, ", \"%s\": %llu", counter_names[c], (unsigned long long)r->values[c]);
+            else fprintf(f, ", \"%s\": null", counter_names[c]);
+        }
+        if (r->running > 0) fprintf(f, ", \"counters_running\": %.3f", r->running);
+        else fprintf(f, ", \"counters_running\": null");
+        if (r->valid[PERF_CYCLES] && r->valid[PERF_INSTRUCTIONS] && r->values[PERF_CYCLES] > 0) {
+            fprintf(f, ", \"ipc\": %.3f",
+                    (double)r->values[PERF_INSTRUCTIONS] / (double)r->values[PERF_CYCLES]);
+        } else {
+            fprintf(f, ", \"ipc\": null");
+        }
+        fprintf(f, "}%s\n", (i + 1 < record_count) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+
+    mem_free(records);
+    records = NULL;
+    record_count = record_capacity = 0;
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef LABIP_PERFCOUNT_H
+#define LABIP_PERFCOUNT_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Аппаратные счетчики (Linux perf_event_open) вокруг стадий обработки.
+// Если счетчики недоступны, записывается только время
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTERS
+};
+
+struct PerfScope {
+    const char *name;
+    int fds[PERF_COUNTERS];
+    struct timespec start;
+    int active;
+};
+
+void perf_enable(const char *json_path);   // включает сбор и задает файл отчета
+int perf_enabled(void);
+
+// Замер стадии: begin/end в одном потоке; без perf_enable ничего не делают
+void perf_scope_begin(struct PerfScope *scope, const char *name);
+void perf_scope_end(struct PerfScope *scope);
+
+int perf_write_json(void);                 // 0 - успех или сбор выключен
+
+#endif // LABIP_PERFCOUNT_H
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include "bmpreader.h"
+#include "memtrack.h"
+#include "pipeline.h"
+#include "perfcount.h"
+
+// Маркер конца потока задач
+#define PIPELINE_END NULL
+
+// Сколько раз ожидающая сторона уступает процессор, прежде чем заснуть
+#define QUEUE_SPIN_COUNT 64
+
+int queue_init(struct JobQueue *q, size_t capacity) {
+    if (capacity == 0) capacity = 1;
+    q->items = mem_alloc(capacity * sizeof(struct PipelineJob *));
+    if (!q->items) return -1;
+    if (pthread_mutex_init(&q->lock, NULL) != 0) {
+        mem_free(q->items);
+        return -1;
+    }
+    if (pthread_cond_init(&q->wakeup, NULL) != 0) {
+        pthread_mutex_destroy(&q->lock);
+        mem_free(q->items);
+        return -1;
+    }
+    q->capacity = capacity;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->sleeping, 0);
+    return 0;
+}
+
+void queue_destroy(struct JobQueue *q) {
+    pthread_cond_destroy(&q->wakeup);
+    pthread_mutex_destroy(&q->lock);
+    mem_free(q->items);
+    q->items = NULL;
+}
+
+typedef int (*QueueBlocked)(struct JobQueue *q, size_t index);
+
+static int queue_full(struct JobQueue *q, size_t tail) {
+    return tail - atomic_load(&q->head) >= q->capacity;
+}
+
+static int queue_empty(struct JobQueue *q, size_t head) {
+    return atomic_load(&q->tail) == head;
+}
+
+// Короткое ожидание без блокировок, затем сон до сигнала другой стороны.
+// sleeping и индексы очереди - seq_cst: либо ждущий увидит новый индекс,
+// либо сигналящий увидит sleeping (и возьмет lock после cond_wait)
+static void queue_wait(struct JobQueue *q, QueueBlocked blocked, size_t index) {
+    for (int spin = 0; spin < QUEUE_SPIN_COUNT; spin++) {
+        if (!blocked(q, index)) return;
+        sched_yield();
+    }
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        atomic_store(&q->sleeping, 1);
+        if (!blocked(q, index)) break;
+        pthread_cond_wait(&q->wakeup, &q->lock);
+    }
+    atomic_store(&q->sleeping, 0);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void queue_notify(struct JobQueue *q) {
+    if (!atomic_load(&q->sleeping)) return;
+    pthread_mutex_lock(&q->lock);
+    pthread_cond_signal(&q->wakeup);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void queue_push(struct JobQueue *q, struct PipelineJob *job) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    // Очередь полна - ждем, пока читатель освободит место
+    queue_wait(q, queue_full, tail);
+    q->items[tail % q->capacity] = job;
+    atomic_store(&q->tail, tail + 1);
+    queue_notify(q);
+}
+
+struct PipelineJob *queue_pop(struct JobQueue *q) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    // Очередь пуста - ждем писателя
+    queue_wait(q, queue_empty, head);
+    struct PipelineJob *job = q->items[head % q->capacity];
+    atomic_store(&q->head, head + 1);
+    queue_notify(q);
+    return job;
+}
+
+struct PipelineContext {
+    struct PipelineJob *jobs;
+    int count;
+    struct JobQueue loaded;     // чтение -> обработка
+    struct JobQueue processed;  // обработка -> запись
+    JobProcessor process;
+    void *ctx;
+};
+
+static void *reader_stage(void *arg) {
+    struct PipelineContext *pc = (struct PipelineContext *)arg;
+    for (int i = 0; i < pc->count; i++) {
+        struct PipelineJob *job = &pc->jobs[i];
+        if (job->status != 0) {
+            // Задача уже провалена вызывающим - передаем дальше, не загружая
+            queue_push(&pc->loaded, job);
+            continue;
+        }
+        struct PerfScope scope;
+        mem_set_stage(MEM_STAGE_LOAD);
+        perf_scope_begin(&scope, "load");
+        job->img = load_bmp(job->input);
+        perf_scope_end(&scope);
+        if (!job->img) {
+            fprintf(stderr, "Error: could not load file '%s'\n", job->input);
+            job->status = -1;
+        }
+        queue_push(&pc->loaded, job);
+    }
+    queue_push(&pc->loaded, PIPELINE_END);
+    return NULL;
+}
+
+static void *writer_stage(void *arg) {
+    struct PipelineContext *pc = (struct PipelineContext *)arg;
+    struct PipelineJob *job;
+    mem_set_stage(MEM_STAGE_SAVE);
+    while ((job = queue_pop(&pc->processed)) != PIPELINE_END) {
+        struct PerfScope scope;
+        perf_scope_begin(&scope, "save");
+        int saved = (job->status == 0) ? save_bmp(job->output, job->img) : 0;
+        perf_scope_end(&scope);
+        if (saved != 0) {
+            fprintf(stderr, "Error: could not save file '%s'\n", job->output);
+            job->status = -1;
+        }
+        free_bmp(job->img);
+        job->img = NULL;
+    }
+    return NULL;
+}
+
+int run_pipeline(struct PipelineJob *jobs, int count, size_t queue_capacity,
+                 JobProcessor process, void *ctx) {
+    struct PipelineContext pc;
+    pc.jobs = jobs;
+    pc.count = count;
+    pc.process = process;
+    pc.ctx = ctx;
+
+    if (queue_init(&pc.loaded, queue_capacity) != 0) return -1;
+    if (queue_init(&pc.processed, queue_capacity) != 0) {
+        queue_destroy(&pc.loaded);
+        return -1;
+    }
+
+    pthread_t reader, writer;
+    if (pthread_create(&reader, NULL, reader_stage, &pc) != 0) {
+        queue_destroy(&pc.loaded);
+        queue_destroy(&pc.processed);
+        return -1;
+    }
+    if (pthread_create(&writer, NULL, writer_stage, &pc) != 0) {
+        // Без писателя продолжать нельзя: дожидаемся читателя и освобождаем загруженное
+        struct PipelineJob *job;
+        while ((job = queue_pop(&pc.loaded)) != PIPELINE_END) {
+            free_bmp(job->img);
+            job->img = NULL;
+        }
+        pthread_join(reader, NULL);
+        queue_destroy(&pc.loaded);
+        queue_destroy(&pc.processed);
+        return -1;
+    }
+
+    // Стадия вычислений выполняется в текущем потоке
+    struct PipelineJob *job;
+    while ((job = queue_pop(&pc.loaded)) != PIPELINE_END) {
+        if (job->status == 0 && pc.process(job, pc.ctx) != 0) {
+            job->status = -1;
+        }
+        queue_push(&pc.processed, job);
+    }
+    queue_push(&pc.processed, PIPELINE_END);
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+    queue_destroy(&pc.loaded);
+    queue_destroy(&pc.processed);
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].status != 0) failed++;
+    }
+    return failed;
+}
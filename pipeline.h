@@ -0,0 +1,42 @@
+#ifndef LABIP_PIPELINE_H
+#define LABIP_PIPELINE_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "bmpreader.h"
+
+// Одна задача пакетной обработки: входной файл -> фильтры -> выходной файл
+struct PipelineJob {
+    const char *input;
+    const char *output;
+    struct BMPImage *img;
+    int status;             // 0 - успех, иначе код ошибки
+};
+
+// Ограниченная lock-free очередь для одного писателя и одного читателя.
+// Ожидающая сторона немного крутится, а затем засыпает на условной переменной
+struct JobQueue {
+    struct PipelineJob **items;
+    size_t capacity;
+    atomic_size_t head;     // следующий элемент для чтения
+    atomic_size_t tail;     // следующая свободная ячейка
+    atomic_int sleeping;    // 1 - одна из сторон ждет на wakeup
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+};
+
+// Стадия вычислений: применяет фильтры к job->img (может заменить img)
+typedef int (*JobProcessor)(struct PipelineJob *job, void *ctx);
+
+int queue_init(struct JobQueue *q, size_t capacity);
+void queue_destroy(struct JobQueue *q);
+void queue_push(struct JobQueue *q, struct PipelineJob *job);   // ждет, если очередь полна
+struct PipelineJob *queue_pop(struct JobQueue *q);              // ждет, если очередь пуста
+
+// Запускает трехстадийный конвейер чтение -> обработка -> запись.
+// Возвращает количество задач, завершившихся с ошибкой, или -1.
+int run_pipeline(struct PipelineJob *jobs, int count, size_t queue_capacity,
+                 JobProcessor process, void *ctx);
+
+#endif // LABIP_PIPELINE_H
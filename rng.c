@@ -0,0 +1,33 @@
+#include <stdint.h>
+#include "rng.h"
+
+void rng_seed(struct Rng *rng, uint64_t seed, uint64_t stream) {
+    rng->state = 0;
+    rng->inc = (stream << 1u) | 1u;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+uint32_t rng_next(struct Rng *rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31u));
+}
+
+// Отбрасываем значения из неполного последнего интервала, чтобы не было
+// смещения, как у rand() % bound
+uint32_t rng_bounded(struct Rng *rng, uint32_t bound) {
+    if (bound == 0) return 0;
+    uint32_t threshold = (-bound) % bound;
+    for (;;) {
+        uint32_t r = rng_next(rng);
+        if (r >= threshold) return r % bound;
+    }
+}
+
+float rng_float(struct Rng *rng) {
+    return (rng_next(rng) >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,18 @@
+#ifndef LABIP_RNG_H
+#define LABIP_RNG_H
+
+#include <stdint.h>
+
+// PCG32: маленький быстрый генератор с независимыми потоками.
+// Одинаковые seed и stream дают одинаковую последовательность на любой платформе
+struct Rng {
+    uint64_t state;
+    uint64_t inc;
+};
+
+void rng_seed(struct Rng *rng, uint64_t seed, uint64_t stream);
+uint32_t rng_next(struct Rng *rng);
+uint32_t rng_bounded(struct Rng *rng, uint32_t bound);   // равномерно в [0, bound)
+float rng_float(struct Rng *rng);                        // равномерно в [0, 1)
+
+#endif // LABIP_RNG_H
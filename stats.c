@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "bmpreader.h"
+#include "memtrack.h"
+#include "filter.h"
+#include "stats.h"
+
+static const char *channel_names[STATS_CHANNELS] = {"blue", "green", "red", "luma"};
+
+struct StatsContext {
+    struct BMPImage *img;
+    struct ImageStats *stats;
+    pthread_mutex_t lock;
+};
+
+static void stats_band(int y_begin, int y_end, void *arg) {
+    struct StatsContext *ctx = (struct StatsContext *)arg;
+    int w = ctx->img->infoHeader.biWidth;
+
+    // Своя гистограмма у каждой полосы - без общих счетчиков в горячем цикле
+    uint32_t local[STATS_CHANNELS][256];
+    memset(local, 0, sizeof(local));
+
+    const struct Pixel *p = ctx->img->data + (size_t)y_begin * w;
+    const struct Pixel *end = ctx->img->data + (size_t)y_end * w;
+    for (; p < end; p++) {
+        float luma = 0.299f * p->r + 0.587f * p->g + 0.114f * p->b;
+        if (luma > 255) luma = 255;
+        local[STATS_BLUE][p->b]++;
+        local[STATS_GREEN][p->g]++;
+        local[STATS_RED][p->r]++;
+        local[STATS_LUMA][(uint8_t)luma]++;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    for (int c = 0; c < STATS_CHANNELS; c++) {
+        for (int v = 0; v < 256; v++) ctx->stats->histogram[c][v] += local[c][v];
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+int compute_image_stats(struct BMPImage *img, struct ImageStats *stats) {
+    int w = img->infoHeader.biWidth;
+    int h = abs(img->infoHeader.biHeight);
+    memset(stats, 0, sizeof(*stats));
+    stats->pixels = (uint64_t)w * h;
+
+    struct StatsContext ctx;
+    ctx.img = img;
+    ctx.stats = stats;
+    if (pthread_mutex_init(&ctx.lock, NULL) != 0) return -1;
+    run_bands(h, stats_band, &ctx);
+    pthread_mutex_destroy(&ctx.lock);
+
+    for (int c = 0; c < STATS_CHANNELS; c++) {
+        uint64_t sum = 0;
+        int min = -1, max = 0;
+        for (int v = 0; v < 256; v++) {
+            uint64_t n = stats->histogram[c][v];
+            if (n == 0) continue;
+            if (min < 0) min = v;
+            max = v;
+            sum += n * v;
+        }
+        stats->min[c] = (uint8_t)(min < 0 ? 0 : min);
+        stats->max[c] = (uint8_t)max;
+        stats->mean[c] = stats->pixels ? (double)sum / (double)stats->pixels : 0.0;
+    }
+    return 0;
+}
+
+// Метод Оцу: порог, максимизирующий межклассовую дисперсию.
+// Пиксели со значением > порога относятся к объекту
+int otsu_threshold(const uint64_t histogram[256]) {
+    uint64_t total = 0;
+    double sum_all = 0;
+    for (int v = 0; v < 256; v++) {
+        total += histogram[v];
+        sum_all += (double)v * histogram[v];
+    }
+    if (total == 0) return 127;
+
+    uint64_t weight_bg = 0;
+    double sum_bg = 0;
+    double best = -1.0;
+    int threshold = 0;
+    for (int t = 0; t < 256; t++) {
+        weight_bg += histogram[t];
+        if (weight_bg == 0) continue;
+        uint64_t weight_fg = total - weight_bg;
+        if (weight_fg == 0) break;
+
+        sum_bg += (double)t * histogram[t];
+        double mean_bg = sum_bg / weight_bg;
+        double mean_fg = (sum_all - sum_bg) / weight_fg;
+        double between = (double)weight_bg * weight_fg * (mean_bg - mean_fg) * (mean_bg - mean_fg);
+        if (between > best) {
+            best = between;
+            threshold = t;
+        }
+    }
+    return threshold;
+}
+
+void print_image_stats(FILE *out, const struct ImageStats *stats, int print_histogram) {
+    fprintf(out, "=== Image statistics ===\n");
+    fprintf(out, "Pixels: %llu\n", (unsigned long long)stats->pixels);
+    fprintf(out, "%-6s %4s %4s %8s %5s\n", "chan", "min", "max", "mean", "otsu");
+    for (int c = 0; c < STATS_CHANNELS; c++) {
+        fprintf(out, "%-6s %4d %4d %8.2f %5d\n", channel_names[c],
+                stats->min[c], stats->max[c], stats->mean[c],
+                otsu_threshold(stats->histogram[c]));
+    }
+    if (print_histogram) {
+        for (int c = 0; c < STATS_CHANNELS; c++) {
+            fprintf(out, "%s histogram:", channel_names[c]);
+            for (int v = 0; v < 256; v++) {
+                fprintf(out, " %llu", (unsigned long long)stats->histogram[c][v]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+    fprintf(out, "========================\n");
+}
+
+struct BMPImage* stats_filter(struct BMPImage *img, void *params) {
+    struct StatsParams *p = (struct StatsParams *)params;
+    struct ImageStats *stats = mem_alloc(sizeof(struct ImageStats));
+    if (!stats) {
+        fprintf(stderr, "Error: cannot allocate memory for statistics\n");
+        return NULL;
+    }
+    if (compute_image_stats(img, stats) != 0) {
+        fprintf(stderr, "Error: cannot compute image statistics\n");
+        mem_free(stats);
+        return NULL;
+    }
+    print_image_stats(stdout, stats, p && p->print_histogram);
+    mem_free(stats);
+    return img;
+}
+
+// ===== ТАБЛИЦЫ ПОДСТАНОВКИ =====
+
+struct LutContext {
+    struct BMPImage *img;
+    uint8_t lut[3][256];    // b, g, r
+};
+
+static void lut_band(int y_begin, int y_end, void *arg) {
+    struct LutContext *ctx = (struct LutContext *)arg;
+    int w = ctx->img->infoHeader.biWidth;
+    struct Pixel *p = ctx->img->data + (size_t)y_begin * w;
+    struct Pixel *end = ctx->img->data + (size_t)y_end * w;
+    for (; p < end; p++) {
+        p->b = ctx->lut[STATS_BLUE][p->b];
+        p->g = ctx->lut[STATS_GREEN][p->g];
+        p->r = ctx->lut[STATS_RED][p->r];
+    }
+}
+
+typedef void (*LutBuilder)(const struct ImageStats *stats, int channel, uint8_t lut[256]);
+
+// Статистика -> таблица на канал -> один проход подстановки на месте
+static struct BMPImage* apply_stats_lut(struct BMPImage *img, LutBuilder build) {
+    struct LutContext *ctx = mem_alloc(sizeof(struct LutContext));
+    struct ImageStats *stats = mem_alloc(sizeof(struct ImageStats));
+    if (!ctx || !stats || compute_image_stats(img, stats) != 0) {
+        fprintf(stderr, "Error: cannot compute image statistics\n");
+        mem_free(ctx);
+        mem_free(stats);
+        return NULL;
+    }
+
+    ctx->img = img;
+    for (int c = STATS_BLUE; c <= STATS_RED; c++) build(stats, c, ctx->lut[c]);
+    run_bands(abs(img->infoHeader.biHeight), lut_band, ctx);
+
+    mem_free(ctx);
+    mem_free(stats);
+    return img;
+}
+
+static void equalize_lut(const struct ImageStats *stats, int channel, uint8_t lut[256]) {
+    const uint64_t *hist = stats->histogram[channel];
+    uint64_t cdf_min = hist[stats->min[channel]];
+    uint64_t range = stats->pixels - cdf_min;
+    uint64_t cdf = 0;
+    for (int v = 0; v < 256; v++) {
+        cdf += hist[v];
+        if (range == 0 || cdf < cdf_min) {
+            lut[v] = (uint8_t)v;
+        } else {
+            lut[v] = (uint8_t)(((cdf - cdf_min) * 255 + range / 2) / range);
+        }
+    }
+}
+
+static void autolevels_lut(const struct ImageStats *stats, int channel, uint8_t lut[256]) {
+    int lo = stats->min[channel];
+    int hi = stats->max[channel];
+    for (int v = 0; v < 256; v++) {
+        if (hi <= lo) lut[v] = (uint8_t)v;
+        else if (v <= lo) lut[v] = 0;
+        else if (v >= hi) lut[v] = 255;
+        else lut[v] = (uint8_t)(((v - lo) * 255 + (hi - lo) / 2) / (hi - lo));
+    }
+}
+
+struct BMPImage* equalize_image(struct BMPImage *img, void *params) {
+    (void)params;
+    return apply_stats_lut(img, equalize_lut);
+}
+
+struct BMPImage* autolevels_image(struct BMPImage *img, void *params) {
+    (void)params;
+    return apply_stats_lut(img, autolevels_lut);
+}
+
+void destroy_stats_params(void *ptr) {
+    struct StatsParams *p = (struct StatsParams *)ptr;
+    if (p) mem_free(p);
+}
@@ -0,0 +1,40 @@
+#ifndef LABIP_STATS_H
+#define LABIP_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "bmpreader.h"
+
+enum StatsChannel {
+    STATS_BLUE,
+    STATS_GREEN,
+    STATS_RED,
+    STATS_LUMA,     // яркость с коэффициентами -gs
+    STATS_CHANNELS
+};
+
+struct ImageStats {
+    uint64_t pixels;
+    uint64_t histogram[STATS_CHANNELS][256];
+    uint8_t min[STATS_CHANNELS];
+    uint8_t max[STATS_CHANNELS];
+    double mean[STATS_CHANNELS];
+};
+
+struct StatsParams {
+    int print_histogram;    // 1 - печатать гистограммы полностью
+};
+
+// Гистограммы за один проход: у каждой полосы своя, в конце они суммируются.
+// min/max/mean считаются по гистограммам
+int compute_image_stats(struct BMPImage *img, struct ImageStats *stats);
+int otsu_threshold(const uint64_t histogram[256]);
+void print_image_stats(FILE *out, const struct ImageStats *stats, int print_histogram);
+
+// Фильтры на таблицах подстановки, построенных по статистике
+struct BMPImage* stats_filter(struct BMPImage *img, void *params);      // -stats: только печать
+struct BMPImage* equalize_image(struct BMPImage *img, void *params);    // выравнивание гистограммы
+struct BMPImage* autolevels_image(struct BMPImage *img, void *params);  // растяжение min..max
+void destroy_stats_params(void *p);
+
+#endif // LABIP_STATS_H
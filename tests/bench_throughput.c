@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "bmpreader.h"
+#include "filter.h"
+#include "memtrack.h"
+
+// Микробенчмарки с порогом пропускной способности.
+// 1) Быстрый путь против эталонного на том же входе: результат должен совпасть,
+//    а время быстрого не может превышать время эталона больше чем в (1 + tolerance) раз.
+// 2) Фильтры на скользящих суммах и морфология: время с большим радиусом не может
+//    превышать время с малым больше чем в (1 + 2 * tolerance) раз. Вдвое больший
+//    допуск - на краевые эффекты (дополнение линии на радиус); прямая свертка
+//    с тем же отношением радиусов была бы медленнее в разы.
+// Запуск: labip_bench [tolerance], по умолчанию 0.25
+
+#define BENCH_WIDTH 1024
+#define BENCH_HEIGHT 768
+#define BENCH_REPEATS 7
+
+typedef struct BMPImage* (*SpecialTransform)(struct BMPImage *img, void *params);
+
+// Один замеряемый вариант: вызов меняет img (или заменяет его через *img)
+struct BenchCase {
+    const char *name;
+    int (*run)(struct BMPImage **img, struct BenchCase *c);
+    PixelTransform transform;
+    struct AccessPattern access;
+    SpecialTransform special;
+    void *params;
+    int reference;          // 1 - выполнять в эталонном режиме
+};
+
+struct BenchResult {
+    double seconds;         // лучшее из BENCH_REPEATS, < 0 - ошибка
+    uint64_t hash;
+};
+
+static struct BMPImage *copy_image(const struct BMPImage *src) {
+    size_t bytes = (size_t)src->infoHeader.biWidth * abs(src->infoHeader.biHeight) * sizeof(struct Pixel);
+    struct BMPImage *img = mem_alloc(sizeof(struct BMPImage));
+    if (!img) return NULL;
+    *img = *src;
+    img->data = mem_alloc(bytes);
+    if (!img->data) {
+        mem_free(img);
+        return NULL;
+    }
+    memcpy(img->data, src->data, bytes);
+    return img;
+}
+
+static double seconds_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int run_pixel(struct BMPImage **img, struct BenchCase *c) {
+    return apply_transform(*img, c->transform, c->params, c->access);
+}
+
+static int run_special(struct BMPImage **img, struct BenchCase *c) {
+    struct BMPImage *result = c->special(*img, c->params);
+    if (!result) return -1;
+    if (result != *img) {
+        free_bmp(*img);
+        *img = result;
+    }
+    return 0;
+}
+
+// Исходная цепочка -edge: grayscale -> Лапласиан -> порог
+static int run_edge_chain(struct BMPImage **img, struct BenchCase *c) {
+    struct formulaFilter gray = {{0.299f, 0.587f, 0.114f}};
+    struct matrixFilter *laplace = create_laplace_kernel();
+    if (!laplace) return -1;
+    int status = apply_transform(*img, formula_transform, &gray, POINT_ACCESS);
+    if (status == 0) status = apply_transform(*img, matrix_transform, laplace, NEIGHBORHOOD_ACCESS(1));
+    if (status == 0) status = apply_transform(*img, threshold_transform, c->params, POINT_ACCESS);
+    destroy_matrix_filter(laplace);
+    return status;
+}
+
+static int run_downscale(struct BMPImage **img, struct BenchCase *c) {
+    (void)c;
+    struct BMPImage *result = downscale_2x(*img);
+    if (!result) return -1;
+    free_bmp(*img);
+    *img = result;
+    return 0;
+}
+
+// Один запуск: копия входа не входит в замер. Лучшее время копится в result
+static int bench_once(const struct BMPImage *src, struct BenchCase *c, struct BenchResult *result) {
+    struct BMPImage *img = copy_image(src);
+    if (!img) return -1;
+    set_reference_mode(c->reference);
+    double start = seconds_now();
+    int status = c->run(&img, c);
+    double elapsed = seconds_now() - start;
+    set_reference_mode(0);
+    if (status == 0) {
+        if (result->seconds < 0 || elapsed < result->seconds) result->seconds = elapsed;
+        result->hash = image_hash(img);
+    }
+    free_bmp(img);
+    return status;
+}
+
+static void print_result(const struct BMPImage *src, const char *name, const struct BenchResult *r) {
+    double mpix = (double)src->infoHeader.biWidth * abs(src->infoHeader.biHeight) / 1e6;
+    printf("%-24s %8.3f ms %9.1f MPix/s\n", name, r->seconds * 1e3, mpix / r->seconds);
+}
+
+// fast и slow замеряются поочередно на одном входе, чтобы фоновая нагрузка
+// влияла на оба одинаково. same_output - результаты должны совпасть,
+// fast не может быть медленнее slow больше чем в (1 + tolerance) раз
+static int gate(const struct BMPImage *src, struct BenchCase *fast, struct BenchCase *slow,
+                int same_output, double tolerance) {
+    struct BenchResult f = {-1.0, 0};
+    struct BenchResult s = {-1.0, 0};
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        if (bench_once(src, fast, &f) != 0 || bench_once(src, slow, &s) != 0) {
+            printf("%-24s FAILED\n", fast->name);
+            return 1;
+        }
+    }
+    print_result(src, fast->name, &f);
+    print_result(src, slow->name, &s);
+
+    int failed = 0;
+    if (same_output && f.hash != s.hash) {
+        printf("  FAIL: %s differs from %s (%016llx vs %016llx)\n", fast->name, slow->name,
+               (unsigned long long)f.hash, (unsigned long long)s.hash);
+        failed = 1;
+    }
+    double limit = s.seconds * (1.0 + tolerance);
+    if (f.seconds > limit) {
+        printf("  FAIL: %s is %.2fx the time of %s (limit %.2fx)\n", fast->name,
+               f.seconds / s.seconds, slow->name, 1.0 + tolerance);
+        failed = 1;
+    }
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    double tolerance = (argc > 1) ? atof(argv[1]) : 0.25;
+    if (tolerance < 0) tolerance = 0;
+
+    struct BMPImage *src = create_synthetic_bmp(BENCH_WIDTH, BENCH_HEIGHT);
+    struct matrixFilter *sharp = create_sharp_kernel();
+    struct matrixFilter *gauss = create_gauss_kernel(2, 1.5f);
+    struct BlurParams *blur_small = create_box_blur_params(2);
+    struct BlurParams *blur_large = create_box_blur_params(32);
+    if (!src || !sharp || !gauss || !blur_small || !blur_large) {
+        fprintf(stderr, "Error: cannot allocate benchmark inputs\n");
+        return 1;
+    }
+    struct EdgeDetectParams edge = {25, EDGE_LAPLACE, 0};
+    struct MorphParams morph_small = {9, 9};
+    struct MorphParams morph_large = {33, 33};
+
+    printf("Throughput on %d x %d, best of %d, tolerance %.2f\n",
+           BENCH_WIDTH, BENCH_HEIGHT, BENCH_REPEATS, tolerance);
+    int failed = 0;
+
+    // Специализации против эталонных реализаций
+    struct BenchCase sharp_fast = {"sharp (specialized)", run_pixel, select_matrix_transform(sharp), NEIGHBORHOOD_ACCESS(1), NULL, sharp, 0};
+    struct BenchCase sharp_ref = {"sharp (reference)", run_pixel, matrix_transform, NEIGHBORHOOD_ACCESS(1), NULL, sharp, 1};
+    failed |= gate(src, &sharp_fast, &sharp_ref, 1, tolerance);
+
+    struct BenchCase gauss_fast = {"gauss5 (specialized)", run_pixel, select_matrix_transform(gauss), NEIGHBORHOOD_ACCESS(2), NULL, gauss, 0};
+    struct BenchCase gauss_ref = {"gauss5 (reference)", run_pixel, matrix_transform, NEIGHBORHOOD_ACCESS(2), NULL, gauss, 1};
+    failed |= gate(src, &gauss_fast, &gauss_ref, 1, tolerance);
+
+    struct BenchCase edge_fast = {"edge (fused)", run_special, NULL, GEOMETRIC_ACCESS, edge_detect, &edge, 0};
+    struct BenchCase edge_ref = {"edge (3-pass reference)", run_edge_chain, NULL, GEOMETRIC_ACCESS, NULL, &edge, 1};
+    failed |= gate(src, &edge_fast, &edge_ref, 1, tolerance);
+
+    struct BenchCase down_fast = {"downscale_2x", run_downscale, NULL, GEOMETRIC_ACCESS, NULL, NULL, 0};
+    struct BenchCase down_ref = {"downscale_2x (reference)", run_downscale, NULL, GEOMETRIC_ACCESS, NULL, NULL, 1};
+    failed |= gate(src, &down_fast, &down_ref, 1, tolerance);
+
+    // Стоимость на пиксель не зависит от радиуса
+    struct BenchCase box_large = {"boxblur r=32", run_special, NULL, GEOMETRIC_ACCESS, box_blur, blur_large, 0};
+    struct BenchCase box_small = {"boxblur r=2", run_special, NULL, GEOMETRIC_ACCESS, box_blur, blur_small, 0};
+    failed |= gate(src, &box_large, &box_small, 0, 2 * tolerance);
+
+    struct BenchCase stack_large = {"stackblur r=32", run_special, NULL, GEOMETRIC_ACCESS, stack_blur, blur_large, 0};
+    struct BenchCase stack_small = {"stackblur r=2", run_special, NULL, GEOMETRIC_ACCESS, stack_blur, blur_small, 0};
+    failed |= gate(src, &stack_large, &stack_small, 0, 2 * tolerance);
+
+    struct BenchCase erode_large = {"erode 33x33", run_special, NULL, GEOMETRIC_ACCESS, erode_image, &morph_large, 0};
+    struct BenchCase erode_small = {"erode 9x9", run_special, NULL, GEOMETRIC_ACCESS, erode_image, &morph_small, 0};
+    failed |= gate(src, &erode_large, &erode_small, 0, 2 * tolerance);
+
+    destroy_matrix_filter(sharp);
+    destroy_matrix_filter(gauss);
+    destroy_blur_params(blur_small);
+    destroy_blur_params(blur_large);
+    free_bmp(src);
+
+    printf(failed ? "Throughput gate FAILED\n" : "Throughput gate passed\n");
+    return failed;
+}
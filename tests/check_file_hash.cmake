@@ -0,0 +1,6 @@
+# Сверка байтов файла с эталонным SHA-256, включая заголовки и паддинг строк
+# cmake -DFILE=<путь> -DEXPECTED=<sha256> -P check_file_hash.cmake
+file(SHA256 ${FILE} actual)
+if (NOT actual STREQUAL EXPECTED)
+    message(FATAL_ERROR "${FILE}: SHA-256 ${actual}, expected ${EXPECTED}")
+endif ()